@@ -0,0 +1,99 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    thread_pool.cpp
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+// Measures how a skewed pipeline scales from 1 to N threads, comparing the
+// work stealing thread_pool against static chunking with one chunk per
+// thread. The last eighth of the input is 64 times more expensive to filter,
+// so with static chunking the thread that gets the last chunk does most of
+// the work while the others sit idle.
+//
+// Build with:
+//     g++ -std=c++11 -O2 -I. bench/thread_pool.cpp -pthread -o bench_thread_pool
+
+#include <linq/extensions.h>
+#include <linq/thread_pool.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+struct skewed_predicate
+{
+    std::size_t heavy_from;
+
+    bool operator()(const std::size_t& x) const
+    {
+        std::size_t rounds = x >= heavy_from ? 64 * 64 : 64;
+        std::size_t h = x;
+        for(std::size_t i = 0; i < rounds; i++) h = h * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (h >> 33) % 3 == 0;
+    }
+};
+
+template<class F>
+double time_ms(F f, long& result)
+{
+    auto start = std::chrono::steady_clock::now();
+    result = f();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+long static_chunks(const std::vector<std::size_t>& v, skewed_predicate p, unsigned threads)
+{
+    std::vector<long> counts(threads, 0);
+    std::vector<std::thread> workers;
+    for(unsigned t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([&, t]
+        {
+            std::size_t first = v.size() * t / threads;
+            std::size_t last = v.size() * (t + 1) / threads;
+            for(std::size_t i = first; i < last; i++) counts[t] += p(v[i]);
+        }));
+    }
+    for(unsigned t = 0; t < threads; t++) workers[t].join();
+    long n = 0;
+    for(unsigned t = 0; t < threads; t++) n += counts[t];
+    return n;
+}
+
+int main(int argc, char ** argv)
+{
+    std::size_t n = argc > 1 ? std::strtoul(argv[1], 0, 10) : (1 << 18);
+    unsigned max_threads = argc > 2 ? std::strtoul(argv[2], 0, 10) : std::thread::hardware_concurrency();
+    if (max_threads == 0) max_threads = 1;
+
+    std::vector<std::size_t> v;
+    for(std::size_t i = 0; i < n; i++) v.push_back(i);
+    skewed_predicate p = { n - n / 8 };
+
+    long expected = v | linq::count(p);
+    double base = 0;
+    std::printf("%8s %12s %12s %10s %10s\n", "threads", "static ms", "stealing ms", "static x", "stealing x");
+    for(unsigned threads = 1; threads <= max_threads; threads++)
+    {
+        long static_result = 0;
+        long stealing_result = 0;
+        // The calling thread helps the pool while it waits, so the pool
+        // only needs threads - 1 workers
+        linq::thread_pool pool(threads > 1 ? threads - 1 : 1);
+        double static_time = time_ms([&] { return static_chunks(v, p, threads); }, static_result);
+        double stealing_time = threads == 1
+            ? time_ms([&] { return v | linq::fused | linq::count(p); }, stealing_result)
+            : time_ms([&] { return v | linq::par(pool) | linq::count(p); }, stealing_result);
+        if (threads == 1) base = stealing_time;
+        if (static_result != expected or stealing_result != expected)
+        {
+            std::printf("wrong result\n");
+            return 1;
+        }
+        std::printf("%8u %12.1f %12.1f %10.2f %10.2f\n", threads, static_time, stealing_time, base / static_time, base / stealing_time);
+    }
+}
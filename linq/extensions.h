@@ -24,7 +24,10 @@
 #include <linq/extensions/find.h>
 #include <linq/extensions/first.h>
 #include <linq/extensions/first_or_default.h>
+#include <linq/extensions/fused.h>
+#include <linq/extensions/group_aggregate.h>
 #include <linq/extensions/group_by.h>
+#include <linq/extensions/group_by_ref.h>
 #include <linq/extensions/group_join.h>
 #include <linq/extensions/intersect.h>
 #include <linq/extensions/join.h>
@@ -32,9 +35,12 @@
 #include <linq/extensions/last.h>
 #include <linq/extensions/last_or_default.h>
 #include <linq/extensions/max.h>
+#include <linq/extensions/merge_join.h>
+#include <linq/extensions/merge_sorted.h>
 #include <linq/extensions/min.h>
 #include <linq/extensions/order_by.h>
 #include <linq/extensions/order_by_descending.h>
+#include <linq/extensions/par.h>
 #include <linq/extensions/reverse.h>
 #include <linq/extensions/select.h>
 #include <linq/extensions/select_many.h>
@@ -43,12 +49,14 @@
 #include <linq/extensions/single_or_default.h>
 #include <linq/extensions/skip.h>
 #include <linq/extensions/skip_while.h>
+#include <linq/extensions/spill.h>
 #include <linq/extensions/sum.h>
 #include <linq/extensions/take.h>
 #include <linq/extensions/take_while.h>
 #include <linq/extensions/then_by.h>
 #include <linq/extensions/then_by_descending.h>
 #include <linq/extensions/to_container.h>
+#include <linq/extensions/to_lookup.h>
 #include <linq/extensions/to_string.h>
 #include <linq/extensions/union.h>
 #include <linq/extensions/values.h>
@@ -10,10 +10,19 @@
 
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <boost/range.hpp>
+#include <boost/optional.hpp>
+#include <boost/mpl/and.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/mpl/not.hpp>
 
 #include <algorithm>
+#include <iterator>
 #include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace linq { 
 
@@ -21,20 +30,148 @@ namespace linq {
 // aggregate
 //
 namespace detail {
+
+template<class T, class Reducer>
+struct aggregate_sink
+{
+    Reducer reducer;
+    boost::optional<T> state;
+
+    aggregate_sink(Reducer reducer)
+    : reducer(reducer)
+    {}
+
+    template<class U>
+    bool operator()(U && x)
+    {
+        if (state) *state = reducer(*state, std::forward<U>(x));
+        else state = std::forward<U>(x);
+        return true;
+    }
+
+    aggregate_sink split() const
+    {
+        return aggregate_sink(reducer);
+    }
+
+    void join(aggregate_sink& other)
+    {
+        if (other.state) (*this)(std::move(*other.state));
+    }
+};
+
+// Each partial of a parallel pipeline starts from a copy of the seed, and the
+// partials are folded together with the combiner, so the seed has to be the
+// identity of the combiner
+template<class T, class Reducer, class Combiner>
+struct accumulate_sink
+{
+    Reducer reducer;
+    Combiner combiner;
+    T seed;
+    T state;
+
+    accumulate_sink(T seed, Reducer reducer, Combiner combiner)
+    : reducer(reducer), combiner(combiner), seed(seed), state(seed)
+    {}
+
+    template<class U>
+    bool operator()(U && x)
+    {
+        state = reducer(state, std::forward<U>(x));
+        return true;
+    }
+
+    accumulate_sink split() const
+    {
+        return accumulate_sink(seed, reducer, combiner);
+    }
+
+    void join(accumulate_sink& other)
+    {
+        state = combiner(state, std::move(other.state));
+    }
+};
+
+// A combiner takes two accumulators, where a selector only takes one
+template<class F, class T, class Enable = void>
+struct is_aggregate_combiner
+: boost::mpl::bool_<false>
+{};
+
+template<class F, class T>
+struct is_aggregate_combiner<F, T, typename holder<decltype(std::declval<F&>()(std::declval<T>(), std::declval<T>()))>::type>
+: boost::mpl::bool_<true>
+{};
+
+template<class Range, class Reducer>
+typename boost::range_value<Range>::type fused_aggregate(const Range& r, Reducer reducer)
+{
+    aggregate_sink<typename boost::range_value<Range>::type, Reducer> sink(reducer);
+    r.push(sink);
+    if (!sink.state) throw std::out_of_range("linq::aggregate failed");
+    return *sink.state;
+}
+
+template<class Range, class Seed, class Reducer, class Combiner>
+Seed fused_accumulate(const Range& r, Seed s, Reducer reducer, Combiner combiner)
+{
+    accumulate_sink<Seed, Reducer, Combiner> sink(s, reducer, combiner);
+    r.push(sink);
+    return sink.state;
+}
+
+// A sequential pipeline never splits the sink, so the combiner isn't used
+template<class Range, class Seed, class Reducer>
+Seed fused_accumulate(const Range& r, Seed s, Reducer reducer)
+{
+    static_assert(!is_parallel_range<Range>::value,
+        "par | aggregate(seed, reducer) needs a combiner for the results of each thread: aggregate(seed, reducer, combiner)");
+    return fused_accumulate(r, s, reducer, reducer);
+}
+
 struct aggregate_t
 {
     //TODO: make it work for empty and single ranges
     template<class Range, class Reducer>
-    auto operator()(Range && r, Reducer reducer) const LINQ_RETURNS
-    (std::accumulate(++boost::begin(r), boost::end(r), *boost::begin(r), make_function_object(reducer)));
+    auto operator()(Range && r, Reducer reducer) const LINQ_RETURN_REQUIRES(boost::mpl::not_<is_fused_range<Range> >)
+    (std::accumulate(std::next(boost::begin(r)), boost::end(r), *boost::begin(r), make_function_object(reducer)));
 
     template<class Range, class Seed, class Reducer>
-    auto operator()(Range && r, Seed && s, Reducer reducer) const LINQ_RETURNS
+    auto operator()(Range && r, Seed && s, Reducer reducer) const LINQ_RETURN_REQUIRES(boost::mpl::not_<is_fused_range<Range> >)
     (std::accumulate(boost::begin(r), boost::end(r), s, make_function_object(reducer)));
 
     template<class Range, class Seed, class Reducer, class Selector>
-    auto operator()(Range && r, Seed && s, Reducer reducer, Selector sel) const LINQ_RETURNS
+    auto operator()(Range && r, Seed && s, Reducer reducer, Selector sel) const LINQ_RETURN_REQUIRES(boost::mpl::and_<boost::mpl::not_<is_fused_range<Range> >, boost::mpl::not_<is_aggregate_combiner<Selector, typename std::decay<Seed>::type> > >)
     (sel(std::accumulate(boost::begin(r), boost::end(r), s, make_function_object(reducer))));
+
+    template<class Range, class Seed, class Reducer, class Combiner>
+    auto operator()(Range && r, Seed && s, Reducer reducer, Combiner) const LINQ_RETURN_REQUIRES(boost::mpl::and_<boost::mpl::not_<is_fused_range<Range> >, is_aggregate_combiner<Combiner, typename std::decay<Seed>::type> >)
+    (std::accumulate(boost::begin(r), boost::end(r), s, make_function_object(reducer)));
+
+    template<class Range, class Seed, class Reducer, class Combiner, class Selector>
+    auto operator()(Range && r, Seed && s, Reducer reducer, Combiner, Selector sel) const LINQ_RETURN_REQUIRES(boost::mpl::not_<is_fused_range<Range> >)
+    (sel(std::accumulate(boost::begin(r), boost::end(r), s, make_function_object(reducer))));
+
+    template<class Range, class Reducer>
+    auto operator()(Range && r, Reducer reducer) const LINQ_RETURN_REQUIRES(is_fused_range<Range>)
+    (fused_aggregate(r, make_function_object(reducer)));
+
+    template<class Range, class Seed, class Reducer>
+    auto operator()(Range && r, Seed && s, Reducer reducer) const LINQ_RETURN_REQUIRES(is_fused_range<Range>)
+    (fused_accumulate(r, s, make_function_object(reducer)));
+
+    template<class Range, class Seed, class Reducer, class Selector>
+    auto operator()(Range && r, Seed && s, Reducer reducer, Selector sel) const LINQ_RETURN_REQUIRES(boost::mpl::and_<is_fused_range<Range>, boost::mpl::not_<is_aggregate_combiner<Selector, typename std::decay<Seed>::type> > >)
+    (sel(fused_accumulate(r, s, make_function_object(reducer))));
+
+    template<class Range, class Seed, class Reducer, class Combiner>
+    auto operator()(Range && r, Seed && s, Reducer reducer, Combiner combiner) const LINQ_RETURN_REQUIRES(boost::mpl::and_<is_fused_range<Range>, is_aggregate_combiner<Combiner, typename std::decay<Seed>::type> >)
+    (fused_accumulate(r, s, make_function_object(reducer), make_function_object(combiner)));
+
+    template<class Range, class Seed, class Reducer, class Combiner, class Selector>
+    auto operator()(Range && r, Seed && s, Reducer reducer, Combiner combiner, Selector sel) const LINQ_RETURN_REQUIRES(is_fused_range<Range>)
+    (sel(fused_accumulate(r, s, make_function_object(reducer), make_function_object(combiner))));
 };
 }
 namespace {
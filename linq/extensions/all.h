@@ -10,6 +10,7 @@
 
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <boost/range.hpp>
 
 namespace linq { 
@@ -18,10 +19,45 @@ namespace linq {
 // all
 //
 namespace detail {
+
+template<class Predicate>
+struct all_sink
+{
+    Predicate p;
+
+    all_sink(Predicate p)
+    : p(p)
+    {}
+
+    template<class T>
+    bool operator()(T && x)
+    {
+        return p(std::forward<T>(x));
+    }
+
+    all_sink split() const
+    {
+        return all_sink(p);
+    }
+
+    void join(const all_sink&)
+    {}
+};
+
 struct all_t
 {
     template<class Range, class Pred>
-    auto operator()(Range && r, Pred p) const LINQ_RETURNS(std::all_of(boost::begin(r), boost::end(r), linq::make_function_object(p)));
+    typename boost::disable_if<is_fused_range<Range>, bool>::type operator()(Range && r, Pred p) const
+    {
+        return std::all_of(boost::begin(r), boost::end(r), linq::make_function_object(p));
+    }
+
+    template<class Range, class Pred>
+    typename boost::enable_if<is_fused_range<Range>, bool>::type operator()(Range && r, Pred p) const
+    {
+        all_sink<function_object<Pred> > sink(linq::make_function_object(p));
+        return r.push(sink);
+    }
 };
 }
 namespace {
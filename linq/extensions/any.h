@@ -10,6 +10,7 @@
 
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <boost/range.hpp>
 
 namespace linq { 
@@ -18,13 +19,53 @@ namespace linq {
 // any
 //
 namespace detail {
+
+template<class Predicate>
+struct any_sink
+{
+    Predicate p;
+    bool found;
+
+    any_sink(Predicate p)
+    : p(p), found(false)
+    {}
+
+    template<class T>
+    bool operator()(T && x)
+    {
+        found = p(std::forward<T>(x));
+        return !found;
+    }
+
+    any_sink split() const
+    {
+        return any_sink(p);
+    }
+
+    void join(const any_sink& other)
+    {
+        found = found or other.found;
+    }
+};
+
 struct any_t
 {
     template<class Range, class Pred>
     auto operator()(Range && r) const LINQ_RETURNS(!boost::empty(r));
 
     template<class Range, class Pred>
-    auto operator()(Range && r, Pred p) const LINQ_RETURNS(std::any_of(boost::begin(r), boost::end(r), linq::make_function_object(p)));
+    typename boost::disable_if<is_fused_range<Range>, bool>::type operator()(Range && r, Pred p) const
+    {
+        return std::any_of(boost::begin(r), boost::end(r), linq::make_function_object(p));
+    }
+
+    template<class Range, class Pred>
+    typename boost::enable_if<is_fused_range<Range>, bool>::type operator()(Range && r, Pred p) const
+    {
+        any_sink<function_object<Pred> > sink(linq::make_function_object(p));
+        r.push(sink);
+        return sink.found;
+    }
 };
 }
 namespace {
@@ -11,6 +11,7 @@
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/always.h>
 #include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <boost/range.hpp>
 
 namespace linq { 
@@ -19,19 +20,90 @@ namespace linq {
 // count
 //
 namespace detail {
+
+struct count_sink
+{
+    long n;
+
+    count_sink()
+    : n(0)
+    {}
+
+    template<class T>
+    bool operator()(T &&)
+    {
+        n++;
+        return true;
+    }
+
+    count_sink split() const
+    {
+        return count_sink();
+    }
+
+    void join(const count_sink& other)
+    {
+        n += other.n;
+    }
+};
+
+template<class Predicate>
+struct count_if_sink
+{
+    Predicate p;
+    long n;
+
+    count_if_sink(Predicate p)
+    : p(p), n(0)
+    {}
+
+    template<class T>
+    bool operator()(T && x)
+    {
+        n += p(std::forward<T>(x)) ? 1 : 0;
+        return true;
+    }
+
+    count_if_sink split() const
+    {
+        return count_if_sink(p);
+    }
+
+    void join(const count_if_sink& other)
+    {
+        n += other.n;
+    }
+};
+
 struct count_t
 {
     template<class Range>
-    long operator()(Range && r) const
+    typename boost::disable_if<is_fused_range<Range>, long>::type operator()(Range && r) const
     {
         return std::distance(boost::begin(r), boost::end(r));
     }
 
     template<class Range, class Pred>
-    long operator()(Range && r, Pred p) const
+    typename boost::disable_if<is_fused_range<Range>, long>::type operator()(Range && r, Pred p) const
     {
         return std::count_if(boost::begin(r), boost::end(r), linq::make_function_object(p));
     }
+
+    template<class Range>
+    typename boost::enable_if<is_fused_range<Range>, long>::type operator()(Range && r) const
+    {
+        count_sink sink;
+        r.push(sink);
+        return sink.n;
+    }
+
+    template<class Range, class Pred>
+    typename boost::enable_if<is_fused_range<Range>, long>::type operator()(Range && r, Pred p) const
+    {
+        count_if_sink<function_object<Pred> > sink(linq::make_function_object(p));
+        r.push(sink);
+        return sink.n;
+    }
 };
 }
 namespace {
@@ -0,0 +1,178 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    flat_map.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_FLAT_MAP_H
+#define LINQ_GUARD_DETAIL_FLAT_MAP_H
+
+#include <linq/extensions/detail/flat_table.h>
+#include <boost/functional/hash.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace linq {
+
+//
+// flat_map
+//
+// A map with one value for each key, where the keys are in a flat_table and
+// the value of the key with id i is values[i]. Iterating the map gives pairs
+// of references to the key and the value, in the order that the keys were
+// inserted.
+//
+namespace detail {
+
+template<class Map, class Value>
+struct flat_map_iterator
+: boost::iterator_facade
+<
+    flat_map_iterator<Map, Value>,
+    std::pair<typename Map::key_type, typename std::remove_const<Value>::type>,
+    boost::random_access_traversal_tag,
+    std::pair<const typename Map::key_type&, Value&>
+>
+{
+    Map * m;
+    std::size_t i;
+
+    flat_map_iterator() : m(nullptr), i(0)
+    {}
+
+    flat_map_iterator(Map * m, std::size_t i) : m(m), i(i)
+    {}
+
+    std::pair<const typename Map::key_type&, Value&> dereference() const
+    {
+        return std::pair<const typename Map::key_type&, Value&>(m->table.keys[i], m->values[i]);
+    }
+
+    bool equal(const flat_map_iterator& other) const
+    {
+        return i == other.i;
+    }
+
+    void increment()
+    {
+        i++;
+    }
+
+    void decrement()
+    {
+        i--;
+    }
+
+    void advance(std::ptrdiff_t n)
+    {
+        i += n;
+    }
+
+    std::ptrdiff_t distance_to(const flat_map_iterator& other) const
+    {
+        return std::ptrdiff_t(other.i) - std::ptrdiff_t(i);
+    }
+};
+
+}
+
+template<class Key, class Value, class Hash = boost::hash<Key>, class Equal = std::equal_to<Key> >
+struct flat_map
+{
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef std::pair<Key, Value> value_type;
+    typedef detail::flat_map_iterator<flat_map, Value> iterator;
+    typedef detail::flat_map_iterator<const flat_map, const Value> const_iterator;
+    typedef std::size_t size_type;
+
+    detail::flat_table<Key, Hash, Equal> table;
+    std::vector<Value> values;
+
+    iterator begin()
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end()
+    {
+        return iterator(this, values.size());
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, values.size());
+    }
+
+    size_type size() const
+    {
+        return values.size();
+    }
+
+    bool empty() const
+    {
+        return values.empty();
+    }
+
+    iterator find(const Key& k)
+    {
+        std::size_t i = table.find(k);
+        return i == table.npos ? this->end() : iterator(this, i);
+    }
+
+    const_iterator find(const Key& k) const
+    {
+        std::size_t i = table.find(k);
+        return i == table.npos ? this->end() : const_iterator(this, i);
+    }
+
+    size_type count(const Key& k) const
+    {
+        return table.find(k) == table.npos ? 0 : 1;
+    }
+
+    const Value& at(const Key& k) const
+    {
+        std::size_t i = table.find(k);
+        if (i == table.npos) throw std::out_of_range("linq::flat_map::at failed");
+        return values[i];
+    }
+
+    Value& at(const Key& k)
+    {
+        std::size_t i = table.find(k);
+        if (i == table.npos) throw std::out_of_range("linq::flat_map::at failed");
+        return values[i];
+    }
+
+    // Returns the value of the key, and inserts the default value first if the
+    // key isn't there
+    template<class K>
+    Value& get(K && k, const Value& default_value)
+    {
+        std::pair<std::size_t, bool> r = table.insert(std::forward<K>(k));
+        if (r.second) values.push_back(default_value);
+        return values[r.first];
+    }
+
+    // The keys, in the order that they were inserted
+    const std::vector<Key>& keys() const
+    {
+        return table.keys;
+    }
+};
+
+}
+
+#endif
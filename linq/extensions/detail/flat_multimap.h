@@ -0,0 +1,157 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    flat_multimap.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_FLAT_MULTIMAP_H
+#define LINQ_GUARD_DETAIL_FLAT_MULTIMAP_H
+
+#include <linq/extensions/detail/flat_table.h>
+#include <boost/functional/hash.hpp>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace linq {
+
+//
+// flat_multimap
+//
+// The multimap that group_by returns. The keys are in a flat_table, and the
+// elements are in one vector, where the elements with the same key are next
+// to each other. So iterating a group, or all of them, reads the elements in
+// order from memory, and equal_range is a lookup in the table.
+//
+// The groups are in the order that their keys first appear in the source,
+// and the elements of each group are in the order of the source, so there's
+// no need to sort the groups again to get the order of the source back.
+//
+// It is built from the whole range at once. The elements are read into the
+// vector and the id of the key of each element is found in the table. Then
+// the elements are counted for each group and moved, so each group starts
+// where the groups before it end.
+//
+template<class Key, class Value, class Hash = boost::hash<Key>, class Equal = std::equal_to<Key> >
+struct flat_multimap
+{
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef std::pair<Key, Value> value_type;
+    typedef std::vector<value_type> vector_type;
+    typedef typename vector_type::iterator iterator;
+    typedef typename vector_type::const_iterator const_iterator;
+    typedef std::size_t size_type;
+
+    detail::flat_table<Key, Hash, Equal> table;
+    // The elements of the group with id i are in [offsets[i], offsets[i + 1])
+    std::vector<std::size_t> offsets;
+    vector_type elements;
+
+    flat_multimap() : offsets(1, 0)
+    {}
+
+    template<class Iterator>
+    flat_multimap(Iterator first, Iterator last)
+    {
+        std::vector<std::size_t> ids;
+        for(; first != last; ++first)
+        {
+            value_type x = *first;
+            ids.push_back(table.insert(x.first).first);
+            elements.push_back(std::move(x));
+        }
+        this->group(ids);
+    }
+
+    // Moves the elements so the groups are contiguous, given the id of the
+    // group of each element. The elements are moved in the order of the
+    // groups, so they don't have to be default constructible.
+    void group(const std::vector<std::size_t>& ids)
+    {
+        std::vector<std::size_t> order = detail::group_order(ids, table.size(), offsets);
+        vector_type grouped;
+        grouped.reserve(elements.size());
+        for(std::size_t i = 0; i < order.size(); i++) grouped.push_back(std::move(elements[order[i]]));
+        elements.swap(grouped);
+    }
+
+    iterator begin()
+    {
+        return elements.begin();
+    }
+
+    iterator end()
+    {
+        return elements.end();
+    }
+
+    const_iterator begin() const
+    {
+        return elements.begin();
+    }
+
+    const_iterator end() const
+    {
+        return elements.end();
+    }
+
+    size_type size() const
+    {
+        return elements.size();
+    }
+
+    bool empty() const
+    {
+        return elements.empty();
+    }
+
+    std::pair<iterator, iterator> equal_range(const Key& k)
+    {
+        std::size_t g = table.find(k);
+        if (g == table.npos) return std::make_pair(elements.end(), elements.end());
+        return std::make_pair(elements.begin() + offsets[g], elements.begin() + offsets[g + 1]);
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(const Key& k) const
+    {
+        std::size_t g = table.find(k);
+        if (g == table.npos) return std::make_pair(elements.end(), elements.end());
+        return std::make_pair(elements.begin() + offsets[g], elements.begin() + offsets[g + 1]);
+    }
+
+    iterator find(const Key& k)
+    {
+        return this->equal_range(k).first;
+    }
+
+    const_iterator find(const Key& k) const
+    {
+        return this->equal_range(k).first;
+    }
+
+    size_type count(const Key& k) const
+    {
+        std::size_t g = table.find(k);
+        return g == table.npos ? 0 : offsets[g + 1] - offsets[g];
+    }
+
+    // The key of each group, in the order of the groups
+    const std::vector<Key>& keys() const
+    {
+        return table.keys;
+    }
+
+    // The elements of the group with id g, where the groups are numbered in
+    // the order of keys()
+    std::pair<const_iterator, const_iterator> group(std::size_t g) const
+    {
+        return std::make_pair(elements.begin() + offsets[g], elements.begin() + offsets[g + 1]);
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,417 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    flat_table.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_FLAT_TABLE_H
+#define LINQ_GUARD_DETAIL_FLAT_TABLE_H
+
+#include <linq/extensions/detail/simd.h>
+#include <boost/functional/hash.hpp>
+#include <boost/mpl/bool.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef LINQ_DENSE_KEY_RANGE
+#define LINQ_DENSE_KEY_RANGE 4096
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LINQ_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define LINQ_PREFETCH(p) ((void)0)
+#endif
+
+namespace linq {
+
+//
+// flat_table
+//
+// An open addressing hash table that gives each distinct key a dense id, in
+// the order that the keys are inserted. The keys are stored contiguously in
+// a vector, and the table itself only has a control byte and the id of the
+// key for each slot. The control byte is either empty, or has 7 bits of the
+// hash of the key. The slots are probed in groups of 16, and the control
+// bytes of a group are compared to the hash at once with SSE2 or NEON, so
+// most lookups only compare a key that matches.
+//
+// Integer and enum keys, with the default hash and equality, are indexed
+// directly instead, as long as they all fall within LINQ_DENSE_KEY_RANGE
+// (4096) values of each other. The id of the key k is at index[k - first],
+// so codes, days and shard ids are never hashed. The first key outside of
+// the range moves the table to hashing for good.
+//
+namespace detail {
+
+const signed char flat_empty = -128;
+
+#if defined(LINQ_SIMD_X86)
+const int flat_match_stride = 1;
+
+inline std::uint64_t flat_match(const signed char * group, signed char h)
+{
+    __m128i control = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return std::uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8(h))));
+}
+#elif defined(LINQ_SIMD_NEON)
+// The comparison is narrowed to 4 bits for each byte, and one of them is kept
+const int flat_match_stride = 4;
+
+inline std::uint64_t flat_match(const signed char * group, signed char h)
+{
+    uint8x16_t eq = vceqq_s8(vld1q_s8(group), vdupq_n_s8(h));
+    uint8x8_t narrow = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrow), 0) & 0x8888888888888888ull;
+}
+#else
+const int flat_match_stride = 1;
+
+inline std::uint64_t flat_match(const signed char * group, signed char h)
+{
+    std::uint64_t result = 0;
+    for(int i = 0; i < 16; i++) result |= std::uint64_t(group[i] == h) << i;
+    return result;
+}
+#endif
+
+inline int flat_ctz(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int result = 0;
+    while (!(x & 1)) { x >>= 1; result++; }
+    return result;
+#endif
+}
+
+// The hash is mixed first, since hashes like boost::hash<int> are just the
+// value, and both the position and the control byte need good bits
+inline std::uint64_t flat_mix(std::uint64_t h)
+{
+    h ^= h >> 32;
+    h *= 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    return h;
+}
+
+// Maps the keys that can be indexed directly to an unsigned integer, in the
+// same order as the keys
+template<class Key, class Enable = void>
+struct flat_dense_key
+: boost::mpl::bool_<false>
+{};
+
+template<class Key>
+struct flat_dense_key<Key, typename std::enable_if<std::is_integral<Key>::value>::type>
+: boost::mpl::bool_<true>
+{
+    static std::uint64_t order(Key k)
+    {
+        return std::is_signed<Key>::value
+            ? std::uint64_t(std::int64_t(k)) ^ (std::uint64_t(1) << 63)
+            : std::uint64_t(k);
+    }
+};
+
+template<class Key>
+struct flat_dense_key<Key, typename std::enable_if<std::is_enum<Key>::value>::type>
+: boost::mpl::bool_<true>
+{
+    typedef typename std::underlying_type<Key>::type underlying;
+
+    static std::uint64_t order(Key k)
+    {
+        return flat_dense_key<underlying>::order(static_cast<underlying>(k));
+    }
+};
+
+template<class Key, class Hash = boost::hash<Key>, class Equal = std::equal_to<Key> >
+struct flat_table
+{
+    static const std::size_t npos = std::size_t(-1);
+    static const std::uint32_t dense_empty = std::uint32_t(-1);
+
+    typedef boost::mpl::bool_
+    <
+        flat_dense_key<Key>::value and
+        std::is_same<Hash, boost::hash<Key> >::value and
+        std::is_same<Equal, std::equal_to<Key> >::value
+    > dense;
+
+    std::vector<Key> keys;
+    std::vector<signed char> control;
+    std::vector<std::size_t> slots;
+    // The id of each key in [first, first + index.size()), until the keys are
+    // hashed
+    std::vector<std::uint32_t> index;
+    std::uint64_t first;
+    bool hashed;
+    Hash hasher;
+    Equal equal;
+
+    flat_table() : first(0), hashed(!dense::value)
+    {}
+
+    std::size_t size() const
+    {
+        return keys.size();
+    }
+
+    std::size_t capacity() const
+    {
+        return control.size();
+    }
+
+    // Returns the id of the key, or npos
+    std::size_t find(const Key& k) const
+    {
+        return this->find(k, this->hash(k));
+    }
+
+    // The hash of the key, so a batch of keys can be hashed and prefetched
+    // before they are found
+    std::uint64_t hash(const Key& k) const
+    {
+        return hashed ? flat_mix(hasher(k)) : 0;
+    }
+
+    void prefetch(std::uint64_t h) const
+    {
+        if (control.empty()) return;
+        std::size_t group = std::size_t(h >> 7) & (control.size() - 1) & ~std::size_t(15);
+        LINQ_PREFETCH(&control[group]);
+        LINQ_PREFETCH(&slots[group]);
+    }
+
+    // Returns the id of the key, given its hash, or npos
+    std::size_t find(const Key& k, std::uint64_t h) const
+    {
+        if (!hashed) return this->find_dense(k, dense());
+        if (control.empty()) return npos;
+        const std::size_t mask = control.size() - 1;
+        signed char h2 = static_cast<signed char>(h & 0x7f);
+        std::size_t group = std::size_t(h >> 7) & mask & ~std::size_t(15);
+        for(std::size_t step = 16;; step += 16)
+        {
+            const signed char * g = &control[group];
+            for(std::uint64_t m = flat_match(g, h2); m != 0; m &= m - 1)
+            {
+                std::size_t i = group + flat_ctz(m) / flat_match_stride;
+                if (equal(keys[slots[i]], k)) return slots[i];
+            }
+            if (flat_match(g, flat_empty) != 0) return npos;
+            group = (group + step) & mask;
+        }
+    }
+
+    // Returns the id of the key, and whether it was inserted
+    template<class K>
+    std::pair<std::size_t, bool> insert(K && k)
+    {
+        std::pair<std::size_t, bool> result;
+        if (!hashed and this->insert_dense(k, result, dense())) return result;
+        if ((keys.size() + 1) * 8 > control.size() * 7) this->rehash(control.empty() ? 16 : control.size() * 2);
+        const std::size_t mask = control.size() - 1;
+        std::uint64_t h = flat_mix(hasher(k));
+        signed char h2 = static_cast<signed char>(h & 0x7f);
+        std::size_t group = std::size_t(h >> 7) & mask & ~std::size_t(15);
+        for(std::size_t step = 16;; step += 16)
+        {
+            const signed char * g = &control[group];
+            for(std::uint64_t m = flat_match(g, h2); m != 0; m &= m - 1)
+            {
+                std::size_t i = group + flat_ctz(m) / flat_match_stride;
+                if (equal(keys[slots[i]], k)) return std::make_pair(slots[i], false);
+            }
+            std::uint64_t empty = flat_match(g, flat_empty);
+            if (empty != 0)
+            {
+                std::size_t i = group + flat_ctz(empty) / flat_match_stride;
+                control[i] = h2;
+                slots[i] = keys.size();
+                keys.push_back(std::forward<K>(k));
+                return std::make_pair(slots[i], true);
+            }
+            group = (group + step) & mask;
+        }
+    }
+
+    // Makes room for n keys without growing
+    void reserve(std::size_t n)
+    {
+        std::size_t c = 16;
+        while (n * 8 > c * 7) c *= 2;
+        if (hashed and c > control.size()) this->rehash(c);
+        keys.reserve(n);
+    }
+
+    std::size_t find_dense(const Key& k, boost::mpl::bool_<true>) const
+    {
+        std::uint64_t i = flat_dense_key<Key>::order(k) - first;
+        return i < index.size() and index[i] != dense_empty ? index[i] : npos;
+    }
+
+    std::size_t find_dense(const Key&, boost::mpl::bool_<false>) const
+    {
+        return npos;
+    }
+
+    // Returns false, without inserting, when the keys have to be hashed
+    template<class K>
+    bool insert_dense(K && k, std::pair<std::size_t, bool>& result, boost::mpl::bool_<true>)
+    {
+        std::uint64_t x = flat_dense_key<Key>::order(k);
+        if (x - first >= index.size() and !this->grow_dense(x)) return false;
+        std::uint32_t& id = index[x - first];
+        if (id != dense_empty)
+        {
+            result = std::make_pair(std::size_t(id), false);
+            return true;
+        }
+        id = std::uint32_t(keys.size());
+        keys.push_back(std::forward<K>(k));
+        result = std::make_pair(std::size_t(id), true);
+        return true;
+    }
+
+    template<class K>
+    bool insert_dense(K &&, std::pair<std::size_t, bool>&, boost::mpl::bool_<false>)
+    {
+        return false;
+    }
+
+    // Makes the index cover x, at least doubling it, or moves the keys into
+    // the hash table when they are too far apart
+    bool grow_dense(std::uint64_t x)
+    {
+        const std::uint64_t range = LINQ_DENSE_KEY_RANGE;
+        std::uint64_t lo = x, hi = x;
+        for(std::size_t id = 0; id < keys.size(); id++)
+        {
+            lo = std::min(lo, flat_dense_key<Key>::order(keys[id]));
+            hi = std::max(hi, flat_dense_key<Key>::order(keys[id]));
+        }
+        if (hi - lo >= range)
+        {
+            hashed = true;
+            index = std::vector<std::uint32_t>();
+            this->reserve(keys.size() + 1);
+            return false;
+        }
+        std::uint64_t n = std::max<std::uint64_t>(std::max<std::uint64_t>(hi - lo + 1, index.size() * 2), 16);
+        n = std::min(n, range);
+        // Grow away from the key that is outside, so keys that go up or down
+        // one at a time don't grow the index every time
+        std::uint64_t start = lo;
+        if (keys.empty()) start = x >= n / 2 ? x - n / 2 : 0;
+        else if (x == lo) start = hi >= n - 1 ? hi - n + 1 : 0;
+        if (start > std::uint64_t(-1) - (n - 1)) start = std::uint64_t(-1) - (n - 1);
+        first = start;
+        index.assign(n, dense_empty);
+        for(std::size_t id = 0; id < keys.size(); id++) index[flat_dense_key<Key>::order(keys[id]) - first] = std::uint32_t(id);
+        return true;
+    }
+
+    void rehash(std::size_t c)
+    {
+        control.assign(c, flat_empty);
+        slots.assign(c, 0);
+        const std::size_t mask = c - 1;
+        for(std::size_t id = 0; id < keys.size(); id++)
+        {
+            std::uint64_t h = flat_mix(hasher(keys[id]));
+            std::size_t group = std::size_t(h >> 7) & mask & ~std::size_t(15);
+            for(std::size_t step = 16;; step += 16)
+            {
+                std::uint64_t empty = flat_match(&control[group], flat_empty);
+                if (empty != 0)
+                {
+                    std::size_t i = group + flat_ctz(empty) / flat_match_stride;
+                    control[i] = static_cast<signed char>(h & 0x7f);
+                    slots[i] = id;
+                    break;
+                }
+                group = (group + step) & mask;
+            }
+        }
+    }
+};
+
+template<class Key, class Hash, class Equal>
+const std::size_t flat_table<Key, Hash, Equal>::npos;
+
+template<class Key, class Hash, class Equal>
+const std::uint32_t flat_table<Key, Hash, Equal>::dense_empty;
+
+// Counts the elements of each group, given the group id of each element, so
+// the elements of group g go in [offsets[g], offsets[g + 1]). Returns the
+// position of each element in the order of the groups, which keeps the order
+// of the elements in each group.
+inline std::vector<std::size_t> group_order(const std::vector<std::size_t>& ids, std::size_t groups, std::vector<std::size_t>& offsets)
+{
+    offsets.assign(groups + 1, 0);
+    for(std::size_t i = 0; i < ids.size(); i++) offsets[ids[i] + 1]++;
+    for(std::size_t g = 0; g < groups; g++) offsets[g + 1] += offsets[g];
+    std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+    std::vector<std::size_t> order(ids.size());
+    for(std::size_t i = 0; i < ids.size(); i++) order[next[ids[i]]++] = i;
+    return order;
+}
+
+// A set on top of the flat table. The elements that are erased keep their id,
+// and are just marked, so erasing doesn't need tombstones in the table.
+template<class T, class Hash = boost::hash<T>, class Equal = std::equal_to<T> >
+struct flat_set
+{
+    flat_table<T, Hash, Equal> table;
+    std::vector<char> present;
+
+    flat_set()
+    {}
+
+    template<class Iterator>
+    flat_set(Iterator first, Iterator last)
+    {
+        for(; first != last; ++first) this->insert(*first);
+    }
+
+    bool contains(const T& x) const
+    {
+        std::size_t id = table.find(x);
+        return id != table.npos and present[id];
+    }
+
+    // Returns true if the element wasn't in the set
+    template<class U>
+    bool insert(U && x)
+    {
+        std::pair<std::size_t, bool> r = table.insert(std::forward<U>(x));
+        if (r.second) present.push_back(true);
+        else if (!present[r.first]) present[r.first] = true;
+        else return false;
+        return true;
+    }
+
+    // Returns true if the element was in the set
+    bool erase(const T& x)
+    {
+        std::size_t id = table.find(x);
+        if (id == table.npos or !present[id]) return false;
+        present[id] = false;
+        return true;
+    }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    fused_range.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_FUSED_RANGE_H
+#define LINQ_GUARD_DETAIL_FUSED_RANGE_H
+
+#include <linq/utility.h>
+#include <linq/traits.h>
+#include <boost/range.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/mpl/not.hpp>
+#include <type_traits>
+#include <utility>
+
+namespace linq {
+
+//
+// fused_range
+//
+// A fused range pushes each element of the source through a chain of sinks,
+// instead of pulling it through a stack of iterator adaptors. Each extension
+// that knows how to push adds a stage to the chain, and the terminal
+// extension drives the whole chain in one loop. The view is the equivalent
+// iterator pipeline, which is used by any extension that can't push.
+//
+namespace detail {
+
+// A sink is called with each element and returns false to stop early. A stage
+// pushes a range of the source into a sink, with its own work wrapped around
+// the sink, and returns false if the sink stopped early.
+template<class Sink>
+struct sink_ref
+{
+    Sink * sink;
+
+    sink_ref(Sink& sink) : sink(&sink)
+    {}
+
+    template<class T>
+    bool operator()(T && x) const
+    {
+        return (*sink)(std::forward<T>(x));
+    }
+};
+
+struct identity_stage
+{
+    template<class Iterator, class Sink>
+    bool push(Iterator first, Iterator last, Sink s) const
+    {
+        for(Iterator it = first; it != last; ++it)
+        {
+            if (!s(*it)) return false;
+        }
+        return true;
+    }
+};
+
+// The policy decides how the source is pushed through the stages
+struct sequential_policy
+{
+    template<class Iterator, class Stage, class Sink>
+    bool run(Iterator first, Iterator last, const Stage& stage, Sink& sink) const
+    {
+        return stage.push(first, last, sink_ref<Sink>(sink));
+    }
+};
+
+}
+
+template<class Iterator, class Stage, class View, class Policy = detail::sequential_policy>
+struct fused_range
+{
+    Iterator first, last;
+    Stage stage;
+    View view;
+    Policy policy;
+
+    typedef typename boost::range_iterator<const View>::type iterator;
+    typedef iterator const_iterator;
+
+    fused_range(Iterator first, Iterator last, Stage stage, View view, Policy policy = Policy())
+    : first(first), last(last), stage(stage), view(view), policy(policy)
+    {}
+
+    // Returns a range with another stage added to the pipeline
+    template<class NextStage, class NextView>
+    fused_range<Iterator, NextStage, NextView, Policy> then(NextStage next_stage, NextView next_view) const
+    {
+        return fused_range<Iterator, NextStage, NextView, Policy>(first, last, next_stage, next_view, policy);
+    }
+
+    iterator begin() const
+    {
+        return boost::begin(view);
+    }
+
+    iterator end() const
+    {
+        return boost::end(view);
+    }
+
+    // Returns false if the sink stopped before the end of the range
+    template<class Sink>
+    bool push(Sink& sink) const
+    {
+        return policy.run(first, last, stage, sink);
+    }
+};
+
+template<class T>
+struct is_fused_range
+: boost::mpl::bool_<false>
+{};
+
+template<class Iterator, class Stage, class View, class Policy>
+struct is_fused_range<fused_range<Iterator, Stage, View, Policy> >
+: boost::mpl::bool_<true>
+{};
+
+template<class T>
+struct is_fused_range<const T>
+: is_fused_range<T>
+{};
+
+template<class T>
+struct is_fused_range<T&>
+: is_fused_range<T>
+{};
+
+template<class T>
+struct is_fused_range<T&&>
+: is_fused_range<T>
+{};
+
+// Fused ranges that don't run sequentially, and so split their sinks
+template<class T>
+struct is_parallel_range
+: boost::mpl::bool_<false>
+{};
+
+template<class Iterator, class Stage, class View, class Policy>
+struct is_parallel_range<fused_range<Iterator, Stage, View, Policy> >
+: boost::mpl::bool_<!std::is_same<Policy, detail::sequential_policy>::value>
+{};
+
+template<class T>
+struct is_parallel_range<const T>
+: is_parallel_range<T>
+{};
+
+template<class T>
+struct is_parallel_range<T&>
+: is_parallel_range<T>
+{};
+
+template<class T>
+struct is_parallel_range<T&&>
+: is_parallel_range<T>
+{};
+
+template<class Iterator, class Stage, class View, class Policy>
+struct is_bindable_range<fused_range<Iterator, Stage, View, Policy> >
+: boost::mpl::bool_<true>
+{};
+
+template<class Iterator, class Stage, class View>
+fused_range<Iterator, Stage, View> make_fused_range(Iterator first, Iterator last, Stage stage, View view)
+{
+    return fused_range<Iterator, Stage, View>(first, last, stage, view);
+}
+
+template<class Iterator, class Stage, class View, class Policy>
+fused_range<Iterator, Stage, View, Policy> make_fused_range(Iterator first, Iterator last, Stage stage, View view, Policy policy)
+{
+    return fused_range<Iterator, Stage, View, Policy>(first, last, stage, view, policy);
+}
+
+}
+
+#endif
@@ -8,8 +8,339 @@
 #ifndef LINQ_GUARD_DETAIL_JOIN_H
 #define LINQ_GUARD_DETAIL_JOIN_H
 
-namespace linq { 
+#include <linq/extensions/detail/identity.h>
+#include <linq/extensions/detail/lookup.h>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/optional.hpp>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
 
+#ifndef LINQ_JOIN_BATCH
+#define LINQ_JOIN_BATCH 16
+#endif
+
+namespace linq {
+
+//
+// join table
+//
+// The build side of join and group_join is a lookup of the inner range, so
+// the keys are in a flat_table and the rows of each key are next to each
+// other. When the inner range is an lvalue of references, the lookup only
+// keeps an iterator to each row. Otherwise the rows are copied, since the
+// inner range goes away before the join is iterated.
+//
+// The outer range is probed in batches of LINQ_JOIN_BATCH (16) elements.
+// The keys of the batch are hashed first, and the slots of their hashes are
+// prefetched, so the cache misses of a batch overlap instead of being paid
+// one after the other. Then each element of the batch is paired with the
+// rows of its key.
+//
+// join builds the table from the outer range instead, when both ranges
+// have random access and the outer range is smaller. The keys of the outer
+// range go in the table, and only the inner rows with one of those keys are
+// kept, in the group of their key. So the results are the same, and in the
+// same order, but only the smaller range is hashed. The kept inner rows are
+// still copied when the inner range is a temporary, so it uses memory for
+// the outer keys and the matching inner rows. The side can be chosen with
+// linq::build_inner or linq::build_outer as the last argument of join, and
+// linq::build_partitioned joins by partitions, as in partitioned_join.h.
+//
+// With linq::probe_inner, the outer range is grouped into the table
+// instead, and the inner range is streamed and probed in batches, so only
+// the outer range is kept. The results are then in the order of the inner
+// range, and for each inner element in the order of the outer range, and
+// the inner range is read while the join is iterated, so it can't be a
+// temporary container.
+//
+namespace detail {
+
+template<int Side>
+struct join_build_side
+{};
+
+typedef join_build_side<0> join_build_auto;
+typedef join_build_side<1> join_build_inner;
+typedef join_build_side<2> join_build_outer;
+typedef join_build_side<3> join_build_partitioned;
+typedef join_build_side<4> join_probe_inner;
+
+template<class Inner, class InnerKeySelector>
+struct as_join_table
+{
+    typedef boost::mpl::bool_
+    <
+        std::is_lvalue_reference<Inner>::value and
+        std::is_reference<typename boost::range_reference<typename std::remove_reference<Inner>::type>::type>::value
+    > by_ref;
+
+    typedef typename std::conditional
+    <
+        by_ref::value,
+        typename as_ref_lookup<Inner, InnerKeySelector>::type,
+        typename as_lookup<Inner, InnerKeySelector, identity_selector>::type
+    >::type type;
+};
+
+template<class Inner, class InnerKeySelector>
+std::shared_ptr<typename as_join_table<Inner, InnerKeySelector>::type> make_join_table(Inner && inner, InnerKeySelector is, boost::mpl::bool_<true>)
+{
+    return std::make_shared<typename as_join_table<Inner, InnerKeySelector>::type>(boost::begin(inner), boost::end(inner), is);
+}
+
+template<class Inner, class InnerKeySelector>
+std::shared_ptr<typename as_join_table<Inner, InnerKeySelector>::type> make_join_table(Inner && inner, InnerKeySelector is, boost::mpl::bool_<false>)
+{
+    return std::make_shared<typename as_join_table<Inner, InnerKeySelector>::type>(boost::begin(inner), boost::end(inner), is, identity_selector());
+}
+
+template<class Inner, class InnerKeySelector>
+std::shared_ptr<typename as_join_table<Inner, InnerKeySelector>::type> make_join_table(Inner && inner, InnerKeySelector is)
+{
+    return make_join_table(std::forward<Inner>(inner), is, typename as_join_table<Inner, InnerKeySelector>::by_ref());
+}
+
+template<class Inner, class InnerKeySelector, class Outer, class OuterKeySelector>
+std::shared_ptr<typename as_join_table<Inner, InnerKeySelector>::type> make_join_table_from_outer(Inner && inner, InnerKeySelector is, Outer && outer, OuterKeySelector os, boost::mpl::bool_<true>)
+{
+    typedef typename as_join_table<Inner, InnerKeySelector>::type table;
+    decltype(std::declval<table>().table) keys;
+    for(auto it = boost::begin(outer); it != boost::end(outer); ++it) keys.insert(typename table::key_type(os(*it)));
+    return std::make_shared<table>(std::move(keys), boost::begin(inner), boost::end(inner), is);
+}
+
+template<class Inner, class InnerKeySelector, class Outer, class OuterKeySelector>
+std::shared_ptr<typename as_join_table<Inner, InnerKeySelector>::type> make_join_table_from_outer(Inner && inner, InnerKeySelector is, Outer && outer, OuterKeySelector os, boost::mpl::bool_<false>)
+{
+    typedef typename as_join_table<Inner, InnerKeySelector>::type table;
+    decltype(std::declval<table>().table) keys;
+    for(auto it = boost::begin(outer); it != boost::end(outer); ++it) keys.insert(typename table::key_type(os(*it)));
+    return std::make_shared<table>(std::move(keys), boost::begin(inner), boost::end(inner), is, identity_selector());
+}
+
+template<class Inner, class InnerKeySelector, class Outer, class OuterKeySelector>
+std::shared_ptr<typename as_join_table<Inner, InnerKeySelector>::type> make_join_table(Inner && inner, InnerKeySelector is, Outer &&, OuterKeySelector, join_build_inner)
+{
+    return make_join_table(std::forward<Inner>(inner), is);
+}
+
+template<class Inner, class InnerKeySelector, class Outer, class OuterKeySelector>
+std::shared_ptr<typename as_join_table<Inner, InnerKeySelector>::type> make_join_table(Inner && inner, InnerKeySelector is, Outer && outer, OuterKeySelector os, join_build_outer)
+{
+    return make_join_table_from_outer(std::forward<Inner>(inner), is, outer, os, typename as_join_table<Inner, InnerKeySelector>::by_ref());
+}
+
+template<class Range>
+struct is_sized_join_range
+: std::is_convertible
+<
+    typename boost::iterator_traversal<typename boost::range_iterator<typename std::remove_reference<Range>::type>::type>::type,
+    boost::random_access_traversal_tag
+>
+{};
+
+template<class Inner, class Outer>
+bool join_outer_is_smaller(Inner && inner, Outer && outer, std::true_type)
+{
+    return boost::size(outer) < boost::size(inner);
+}
+
+template<class Inner, class Outer>
+bool join_outer_is_smaller(Inner &&, Outer &&, std::false_type)
+{
+    return false;
+}
+
+template<class Inner, class InnerKeySelector, class Outer, class OuterKeySelector>
+std::shared_ptr<typename as_join_table<Inner, InnerKeySelector>::type> make_join_table(Inner && inner, InnerKeySelector is, Outer && outer, OuterKeySelector os, join_build_auto)
+{
+    typedef std::integral_constant<bool, is_sized_join_range<Inner>::value and is_sized_join_range<Outer>::value> sized;
+    if (join_outer_is_smaller(inner, outer, sized())) return make_join_table(std::forward<Inner>(inner), is, outer, os, join_build_outer());
+    else return make_join_table(std::forward<Inner>(inner), is);
+}
+
+// Finds the group of the key of each outer element, from first to last,
+// with the slots of the whole batch prefetched first
+template<class Table, class Iterator, class OuterKeySelector>
+void probe_join_table(const Table& t, const Iterator * first, const Iterator * last, OuterKeySelector& os, std::size_t * groups)
+{
+    const std::size_t n = last - first;
+    boost::optional<typename Table::key_type> keys[LINQ_JOIN_BATCH];
+    std::uint64_t hashes[LINQ_JOIN_BATCH];
+    for(std::size_t i = 0; i < n; i++)
+    {
+        keys[i] = typename Table::key_type(os(*first[i]));
+        hashes[i] = t.table.hash(*keys[i]);
+        t.table.prefetch(hashes[i]);
+    }
+    for(std::size_t i = 0; i < n; i++) groups[i] = t.table.find(*keys[i], hashes[i]);
+}
+
+template<class Iterator, class Table, class OuterKeySelector, class ResultSelector>
+struct join_iterator_types
+{
+    typedef typename Table::value_iterator row_iterator;
+    typedef decltype(std::declval<const ResultSelector&>()
+    (
+        std::declval<typename boost::iterator_reference<Iterator>::type>(),
+        std::declval<typename boost::iterator_reference<row_iterator>::type>()
+    )) reference;
+    typedef typename std::decay<reference>::type value_type;
+};
+
+template<class Iterator, class Table, class OuterKeySelector, class ResultSelector>
+struct join_iterator
+: boost::iterator_facade
+<
+    join_iterator<Iterator, Table, OuterKeySelector, ResultSelector>,
+    typename join_iterator_types<Iterator, Table, OuterKeySelector, ResultSelector>::value_type,
+    boost::forward_traversal_tag,
+    typename join_iterator_types<Iterator, Table, OuterKeySelector, ResultSelector>::reference
+>
+{
+    typedef typename join_iterator_types<Iterator, Table, OuterKeySelector, ResultSelector>::row_iterator row_iterator;
+    typedef typename join_iterator_types<Iterator, Table, OuterKeySelector, ResultSelector>::reference reference;
+
+    std::shared_ptr<const Table> t;
+    OuterKeySelector os;
+    ResultSelector rs;
+    // The outer elements that aren't in the batch yet
+    Iterator next, last;
+    // The outer elements of the batch, and the group of each of their keys.
+    // They are part of the iterator, so each copy of it copies
+    // LINQ_JOIN_BATCH outer iterators and group ids.
+    Iterator batch[LINQ_JOIN_BATCH];
+    std::size_t groups[LINQ_JOIN_BATCH];
+    std::size_t pos, count;
+    // The rows of the current outer element that are left
+    row_iterator row, row_end;
+
+    join_iterator() : batch(), groups(), pos(0), count(0)
+    {}
+
+    join_iterator(std::shared_ptr<const Table> t, OuterKeySelector os, ResultSelector rs, Iterator first, Iterator last)
+    : t(t), os(os), rs(rs), next(first), last(last), batch(), groups(), pos(0), count(0)
+    {
+        this->find_match();
+    }
+
+    // The end
+    join_iterator(std::shared_ptr<const Table> t, OuterKeySelector os, ResultSelector rs, Iterator last)
+    : t(t), os(os), rs(rs), next(last), last(last), batch(), groups(), pos(0), count(0)
+    {}
+
+    bool done() const
+    {
+        return pos == count and next == last;
+    }
+
+    void fill()
+    {
+        for(count = 0; count < LINQ_JOIN_BATCH and next != last; count++, ++next) batch[count] = next;
+        probe_join_table(*t, batch, batch + count, os, groups);
+        pos = 0;
+    }
+
+    // Moves to the next outer element with rows, starting at pos
+    void find_match()
+    {
+        for(;;)
+        {
+            if (pos == count)
+            {
+                if (next == last) return;
+                this->fill();
+            }
+            if (groups[pos] != t->table.npos)
+            {
+                typename Table::value_type g = t->group(groups[pos]);
+                row = g.begin();
+                row_end = g.end();
+                if (row != row_end) return;
+            }
+            pos++;
+        }
+    }
+
+    reference dereference() const
+    {
+        return rs(*batch[pos], *row);
+    }
+
+    void increment()
+    {
+        if (++row != row_end) return;
+        pos++;
+        this->find_match();
+    }
+
+    bool equal(const join_iterator& other) const
+    {
+        if (this->done() or other.done()) return this->done() == other.done();
+        return batch[pos] == other.batch[other.pos] and row == other.row;
+    }
+};
+
+template<class Outer, class Table, class OuterKeySelector, class ResultSelector>
+struct join_range_types
+{
+    typedef join_iterator<typename boost::range_iterator<typename std::remove_reference<Outer>::type>::type, Table, OuterKeySelector, ResultSelector> iterator;
+    typedef boost::iterator_range<iterator> type;
+};
+
+template<class Outer, class Table, class OuterKeySelector, class ResultSelector>
+typename join_range_types<Outer, Table, OuterKeySelector, ResultSelector>::type
+make_join_range(Outer && outer, std::shared_ptr<Table> t, OuterKeySelector os, ResultSelector rs)
+{
+    typedef typename join_range_types<Outer, Table, OuterKeySelector, ResultSelector>::iterator iterator;
+    return boost::make_iterator_range
+    (
+        iterator(t, os, rs, boost::begin(outer), boost::end(outer)),
+        iterator(t, os, rs, boost::end(outer))
+    );
+}
+
+// Passes the elements to the result selector in the other order, when the
+// inner range probes a table of the outer range
+template<class ResultSelector>
+struct swapped_result_selector
+{
+    ResultSelector rs;
+
+    swapped_result_selector()
+    {}
+
+    swapped_result_selector(ResultSelector rs) : rs(rs)
+    {}
+
+    template<class Inner, class Outer>
+    auto operator()(Inner && inner, Outer && outer) const LINQ_RETURNS
+    (rs(std::forward<Outer>(outer), std::forward<Inner>(inner)));
+};
+
+template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+typename join_range_types<Inner, typename as_join_table<Outer&, OuterKeySelector>::type, InnerKeySelector, swapped_result_selector<ResultSelector> >::type
+make_probe_inner_join_range(Outer && outer, Inner && inner, OuterKeySelector os, InnerKeySelector is, ResultSelector rs)
+{
+    static_assert(std::is_lvalue_reference<Inner>::value or !std::is_reference<typename boost::range_reference<typename std::remove_reference<Inner>::type>::type>::value,
+        "join with linq::probe_inner reads the inner range while it is iterated, so it can't be a temporary container");
+    return make_join_range(inner, make_join_table(outer, os), is, swapped_result_selector<ResultSelector>(rs));
+}
+
+}
+
+namespace {
+detail::join_build_inner build_inner = {};
+detail::join_build_outer build_outer = {};
+detail::join_build_partitioned build_partitioned = {};
+detail::join_probe_inner probe_inner = {};
+}
 
 }
 
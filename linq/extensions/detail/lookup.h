@@ -0,0 +1,395 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    lookup.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_LOOKUP_H
+#define LINQ_GUARD_DETAIL_LOOKUP_H
+
+#include <linq/extensions/detail/flat_table.h>
+#include <boost/functional/hash.hpp>
+#include <boost/iterator/indirect_iterator.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/range.hpp>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace linq {
+
+//
+// lookup
+//
+// The groups of a range in a compact layout. Each key is stored once, in a
+// flat_table, and the values of all of the groups are in one vector, so the
+// values of the group with id g are in [offsets[g], offsets[g + 1]).
+// Iterating the lookup gives a grouping for each key, which is a range of
+// its values with a key() member function, so per group reductions read
+// the values in order from memory.
+//
+// It is built in two passes over the source. The first pass finds the id of
+// the key of each element and counts the groups, and the second pass puts
+// the values in their place.
+//
+template<class Key, class Iterator>
+struct grouping
+: boost::iterator_range<Iterator>
+{
+    const Key * k;
+
+    grouping(const Key& k, Iterator first, Iterator last)
+    : boost::iterator_range<Iterator>(first, last), k(&k)
+    {}
+
+    const Key& key() const
+    {
+        return *k;
+    }
+};
+
+namespace detail {
+
+template<class Lookup>
+struct lookup_iterator
+: boost::iterator_facade
+<
+    lookup_iterator<Lookup>,
+    typename Lookup::value_type,
+    boost::random_access_traversal_tag,
+    typename Lookup::value_type
+>
+{
+    const Lookup * l;
+    std::size_t g;
+
+    lookup_iterator() : l(nullptr), g(0)
+    {}
+
+    lookup_iterator(const Lookup * l, std::size_t g) : l(l), g(g)
+    {}
+
+    typename Lookup::value_type dereference() const
+    {
+        return l->group(g);
+    }
+
+    bool equal(const lookup_iterator& other) const
+    {
+        return g == other.g;
+    }
+
+    void increment()
+    {
+        g++;
+    }
+
+    void decrement()
+    {
+        g--;
+    }
+
+    void advance(std::ptrdiff_t n)
+    {
+        g += n;
+    }
+
+    std::ptrdiff_t distance_to(const lookup_iterator& other) const
+    {
+        return std::ptrdiff_t(other.g) - std::ptrdiff_t(g);
+    }
+};
+
+}
+
+namespace detail {
+
+// Finds the elements whose key is already in the table, and returns them in
+// the order of the groups, which keeps the order of the elements in each
+// group. The groups of the keys that no element has are empty.
+template<class Table, class Iterator, class KeySelector>
+std::vector<Iterator> matching_rows(const Table& table, Iterator first, Iterator last, KeySelector ks, std::vector<std::size_t>& offsets)
+{
+    std::vector<std::size_t> ids;
+    std::vector<Iterator> matches;
+    for(; first != last; ++first)
+    {
+        std::size_t g = table.find(ks(*first));
+        if (g == table.npos) continue;
+        ids.push_back(g);
+        matches.push_back(first);
+    }
+    std::vector<std::size_t> order = group_order(ids, table.size(), offsets);
+    std::vector<Iterator> result;
+    result.reserve(order.size());
+    for(std::size_t i = 0; i < order.size(); i++) result.push_back(matches[order[i]]);
+    return result;
+}
+
+}
+
+template<class Key, class Value, class Hash = boost::hash<Key>, class Equal = std::equal_to<Key> >
+struct lookup
+{
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef typename std::vector<Value>::const_iterator value_iterator;
+    typedef grouping<Key, value_iterator> value_type;
+    typedef detail::lookup_iterator<lookup> iterator;
+    typedef iterator const_iterator;
+    typedef std::size_t size_type;
+
+    detail::flat_table<Key, Hash, Equal> table;
+    std::vector<std::size_t> offsets;
+    std::vector<Value> values;
+
+    lookup() : offsets(1, 0)
+    {}
+
+    template<class Iterator, class KeySelector, class ElementSelector>
+    lookup(Iterator first, Iterator last, KeySelector ks, ElementSelector es)
+    {
+        std::vector<std::size_t> ids;
+        for(Iterator it = first; it != last; ++it) ids.push_back(table.insert(ks(*it)).first);
+        std::vector<std::size_t> order = detail::group_order(ids, table.size(), offsets);
+        this->fill(first, order, es, typename std::iterator_traits<Iterator>::iterator_category());
+    }
+
+    // Groups only the elements whose key is one of the keys given, so the
+    // groups are in the order of those keys, and some can be empty
+    template<class Iterator, class KeySelector, class ElementSelector>
+    lookup(detail::flat_table<Key, Hash, Equal> keys, Iterator first, Iterator last, KeySelector ks, ElementSelector es)
+    : table(std::move(keys))
+    {
+        std::vector<Iterator> rows = detail::matching_rows(table, first, last, ks, offsets);
+        values.reserve(rows.size());
+        for(std::size_t i = 0; i < rows.size(); i++) values.push_back(es(*rows[i]));
+    }
+
+    template<class Iterator, class ElementSelector>
+    void fill(Iterator first, const std::vector<std::size_t>& order, ElementSelector es, std::random_access_iterator_tag)
+    {
+        values.reserve(order.size());
+        for(std::size_t i = 0; i < order.size(); i++) values.push_back(es(first[order[i]]));
+    }
+
+    // Without random access, the positions are inverted instead, so the
+    // source is read in order and each value is put in its place
+    template<class Iterator, class ElementSelector, class Category>
+    void fill(Iterator first, const std::vector<std::size_t>& order, ElementSelector es, Category)
+    {
+        std::vector<std::size_t> position(order.size());
+        for(std::size_t i = 0; i < order.size(); i++) position[order[i]] = i;
+        std::vector<Value> result(order.size());
+        for(std::size_t i = 0; i < order.size(); i++, ++first) result[position[i]] = es(*first);
+        values.swap(result);
+    }
+
+    value_type group(std::size_t g) const
+    {
+        return value_type(table.keys[g], values.begin() + offsets[g], values.begin() + offsets[g + 1]);
+    }
+
+    iterator begin() const
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator(this, table.size());
+    }
+
+    // The number of groups
+    size_type size() const
+    {
+        return table.size();
+    }
+
+    bool empty() const
+    {
+        return table.size() == 0;
+    }
+
+    bool contains(const Key& k) const
+    {
+        return table.find(k) != table.npos;
+    }
+
+    iterator find(const Key& k) const
+    {
+        std::size_t g = table.find(k);
+        return g == table.npos ? this->end() : iterator(this, g);
+    }
+
+    // The values of the key, which are empty when the key isn't there
+    boost::iterator_range<value_iterator> operator[](const Key& k) const
+    {
+        std::size_t g = table.find(k);
+        if (g == table.npos) return boost::iterator_range<value_iterator>(values.end(), values.end());
+        return boost::iterator_range<value_iterator>(values.begin() + offsets[g], values.begin() + offsets[g + 1]);
+    }
+
+    // The keys, in the order of the groups
+    const std::vector<Key>& keys() const
+    {
+        return table.keys;
+    }
+};
+
+//
+// ref_lookup
+//
+// A lookup that doesn't copy the elements. It keeps an iterator into the
+// source for each element, in the order of the groups, and the groups are
+// ranges of references to the elements of the source, so the source has to
+// outlive it. Each element costs an iterator, whatever its size.
+//
+template<class Key, class Iterator, class Hash = boost::hash<Key>, class Equal = std::equal_to<Key> >
+struct ref_lookup
+{
+    typedef Key key_type;
+    typedef typename boost::iterator_value<Iterator>::type mapped_type;
+    typedef boost::indirect_iterator<typename std::vector<Iterator>::const_iterator> value_iterator;
+    typedef grouping<Key, value_iterator> value_type;
+    typedef detail::lookup_iterator<ref_lookup> iterator;
+    typedef iterator const_iterator;
+    typedef std::size_t size_type;
+
+    detail::flat_table<Key, Hash, Equal> table;
+    std::vector<std::size_t> offsets;
+    std::vector<Iterator> rows;
+
+    ref_lookup() : offsets(1, 0)
+    {}
+
+    template<class KeySelector>
+    ref_lookup(Iterator first, Iterator last, KeySelector ks)
+    {
+        std::vector<std::size_t> ids;
+        for(Iterator it = first; it != last; ++it) ids.push_back(table.insert(ks(*it)).first);
+        std::vector<std::size_t> order = detail::group_order(ids, table.size(), offsets);
+        this->fill(first, order, typename std::iterator_traits<Iterator>::iterator_category());
+    }
+
+    // Groups only the elements whose key is one of the keys given, so the
+    // groups are in the order of those keys, and some can be empty
+    template<class KeySelector>
+    ref_lookup(detail::flat_table<Key, Hash, Equal> keys, Iterator first, Iterator last, KeySelector ks)
+    : table(std::move(keys)), rows(detail::matching_rows(table, first, last, ks, offsets))
+    {}
+
+    void fill(Iterator first, const std::vector<std::size_t>& order, std::random_access_iterator_tag)
+    {
+        rows.reserve(order.size());
+        for(std::size_t i = 0; i < order.size(); i++) rows.push_back(first + order[i]);
+    }
+
+    template<class Category>
+    void fill(Iterator first, const std::vector<std::size_t>& order, Category)
+    {
+        std::vector<Iterator> all;
+        all.reserve(order.size());
+        for(std::size_t i = 0; i < order.size(); i++, ++first) all.push_back(first);
+        rows.reserve(order.size());
+        for(std::size_t i = 0; i < order.size(); i++) rows.push_back(all[order[i]]);
+    }
+
+    value_type group(std::size_t g) const
+    {
+        return value_type(table.keys[g], value_iterator(rows.begin() + offsets[g]), value_iterator(rows.begin() + offsets[g + 1]));
+    }
+
+    iterator begin() const
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator(this, table.size());
+    }
+
+    // The number of groups
+    size_type size() const
+    {
+        return table.size();
+    }
+
+    bool empty() const
+    {
+        return table.size() == 0;
+    }
+
+    bool contains(const Key& k) const
+    {
+        return table.find(k) != table.npos;
+    }
+
+    iterator find(const Key& k) const
+    {
+        std::size_t g = table.find(k);
+        return g == table.npos ? this->end() : iterator(this, g);
+    }
+
+    // The elements of the key, which are empty when the key isn't there
+    boost::iterator_range<value_iterator> operator[](const Key& k) const
+    {
+        std::size_t g = table.find(k);
+        if (g == table.npos) return boost::iterator_range<value_iterator>(value_iterator(rows.end()), value_iterator(rows.end()));
+        return boost::iterator_range<value_iterator>(value_iterator(rows.begin() + offsets[g]), value_iterator(rows.begin() + offsets[g + 1]));
+    }
+
+    // The keys, in the order of the groups
+    const std::vector<Key>& keys() const
+    {
+        return table.keys;
+    }
+};
+
+namespace detail {
+
+template<class Range, class KeySelector, class ElementSelector>
+struct as_lookup
+{
+    typedef typename boost::range_reference<typename std::remove_reference<Range>::type>::type reference;
+    typedef lookup
+    <
+        typename std::decay<decltype(std::declval<KeySelector>()(std::declval<reference>()))>::type,
+        typename std::decay<decltype(std::declval<ElementSelector>()(std::declval<reference>()))>::type
+    > type;
+};
+
+template<class Range, class KeySelector, class ElementSelector>
+typename as_lookup<Range, KeySelector, ElementSelector>::type make_lookup(Range && r, KeySelector ks, ElementSelector es)
+{
+    return typename as_lookup<Range, KeySelector, ElementSelector>::type(boost::begin(r), boost::end(r), ks, es);
+}
+
+template<class Range, class KeySelector>
+struct as_ref_lookup
+{
+    typedef typename boost::range_reference<typename std::remove_reference<Range>::type>::type reference;
+    typedef ref_lookup
+    <
+        typename std::decay<decltype(std::declval<KeySelector>()(std::declval<reference>()))>::type,
+        typename boost::range_iterator<typename std::remove_reference<Range>::type>::type
+    > type;
+};
+
+template<class Range, class KeySelector>
+typename as_ref_lookup<Range, KeySelector>::type make_ref_lookup(Range && r, KeySelector ks)
+{
+    static_assert(std::is_reference<typename as_ref_lookup<Range, KeySelector>::reference>::value, "group_by_ref needs a range of references to elements that outlive the groups");
+    return typename as_ref_lookup<Range, KeySelector>::type(boost::begin(r), boost::end(r), ks);
+}
+
+}
+
+}
+
+#endif
@@ -11,7 +11,8 @@
 #include <linq/utility.h>
 #include <linq/traits.h>
 #include <boost/range.hpp>
-#include <boost/unordered_map.hpp>
+#include <linq/extensions/detail/flat_multimap.h>
+#include <map>
 #include <memory>
 
 namespace linq { 
@@ -19,16 +20,16 @@ namespace linq {
 namespace detail {
 
 template<class R>
-struct as_unordered_map
+struct as_flat_multimap
 {
     typedef typename boost::range_value<typename std::decay<R>::type>::type value_type;
-    typedef boost::unordered_multimap<typename value_type::first_type, typename value_type::second_type> type;
+    typedef flat_multimap<typename std::decay<typename value_type::first_type>::type, typename value_type::second_type> type;
 };
 
 template<class R>
 struct as_shared_map
 {
-    typedef std::shared_ptr<typename as_unordered_map<R>::type> type;
+    typedef std::shared_ptr<typename as_flat_multimap<R>::type> type;
 };
 
 template<class R, class Compare>
@@ -40,21 +41,20 @@ struct as_map
 
 
 template<class Range>
-typename as_unordered_map<Range>::type make_map(Range && r)
+typename as_flat_multimap<Range>::type make_map(Range && r)
 {
-    return typename as_unordered_map<Range>::type(boost::begin(r), boost::end(r));
+    return typename as_flat_multimap<Range>::type(boost::begin(r), boost::end(r));
 }
-// (boost::unordered_multimap<decltype(boost::begin(r)->first), decltype(boost::begin(r)->second)>(boost::begin(r), boost::end(r)));
 
 template<class Range>
-std::shared_ptr<typename as_unordered_map<Range>::type> make_shared_map(Range && r)
+std::shared_ptr<typename as_flat_multimap<Range>::type> make_shared_map(Range && r)
 {
-    return std::make_shared<typename as_unordered_map<Range>::type>(boost::begin(r), boost::end(r));
+    return std::make_shared<typename as_flat_multimap<Range>::type>(boost::begin(r), boost::end(r));
 }
 
 // template<class Range>
 // auto make_shared_map(Range && r) LINQ_RETURN_REQUIRES(is_range<Range>)
-// (std::make_shared<boost::unordered_multimap<decltype(boost::begin(r)->first), decltype(boost::begin(r)->second)> >(boost::begin(r), boost::end(r)));
+// (std::make_shared<flat_multimap<decltype(boost::begin(r)->first), decltype(boost::begin(r)->second)> >(boost::begin(r), boost::end(r)));
 
 template<class Range, class Compare>
 typename as_map<Range, Compare>::type make_map(Range && r, Compare c)
@@ -0,0 +1,235 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    merged_range.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_MERGED_RANGE_H
+#define LINQ_GUARD_DETAIL_MERGED_RANGE_H
+
+#include <linq/extensions/detail/ordered_range.h>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/range.hpp>
+#include <linq/traits.h>
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace linq {
+
+//
+// merged_range
+//
+// Merges several ranges that are each already sorted by the key, without
+// sorting them again. The iterator keeps a heap with the next element of
+// each range and its key, so the key of each element is computed once, and
+// incrementing the iterator only moves the heap. The heap is shared by the
+// copies of the iterator, and it is only copied when an iterator that shares
+// it is incremented, so copying the iterator and iterating it in a loop
+// don't allocate. Equal keys come from the earlier range first, so the merge
+// is stable. The elements are references to the elements of the sources.
+//
+// A then_by on the merged range orders the elements by the keys together,
+// which sorts them like an order_by. Equal keys are already in the order of
+// the sources, so the elements of the sources are sorted one after the
+// other, without merging them first.
+//
+namespace detail {
+
+template<class Iterator, class Key>
+struct merge_iterator
+: boost::iterator_facade
+<
+    merge_iterator<Iterator, Key>,
+    typename boost::iterator_value<Iterator>::type,
+    boost::forward_traversal_tag,
+    typename boost::iterator_reference<Iterator>::type
+>
+{
+    typedef typename std::decay<decltype(std::declval<const Key&>()(*std::declval<Iterator>()))>::type key_type;
+
+    struct head
+    {
+        key_type key;
+        Iterator first, last;
+        std::size_t source;
+
+        head(key_type key, Iterator first, Iterator last, std::size_t source)
+        : key(std::move(key)), first(first), last(last), source(source)
+        {}
+    };
+
+    struct head_compare
+    {
+        Key key;
+
+        head_compare(Key key) : key(key)
+        {}
+
+        // The heap keeps the greatest element first, so this is reversed
+        bool operator()(const head& x, const head& y) const
+        {
+            if (key.less(y.key, x.key)) return true;
+            if (key.less(x.key, y.key)) return false;
+            return y.source < x.source;
+        }
+    };
+
+    Key key;
+    std::shared_ptr<std::vector<head> > heads;
+    std::size_t position;
+
+    merge_iterator() : position(0)
+    {}
+
+    merge_iterator(const std::vector<std::pair<Iterator, Iterator> >& sources, Key key)
+    : key(key), heads(std::make_shared<std::vector<head> >()), position(0)
+    {
+        for(std::size_t i = 0; i < sources.size(); i++)
+        {
+            if (sources[i].first != sources[i].second) heads->push_back(head(key(*sources[i].first), sources[i].first, sources[i].second, i));
+        }
+        std::make_heap(heads->begin(), heads->end(), head_compare(key));
+    }
+
+    bool at_end() const
+    {
+        return !heads or heads->empty();
+    }
+
+    bool equal(const merge_iterator& other) const
+    {
+        return this->at_end() == other.at_end() and (this->at_end() or position == other.position);
+    }
+
+    void increment()
+    {
+        if (heads.use_count() > 1) heads = std::make_shared<std::vector<head> >(*heads);
+        head_compare c(key);
+        std::pop_heap(heads->begin(), heads->end(), c);
+        head& h = heads->back();
+        if (++h.first == h.last) heads->pop_back();
+        else
+        {
+            h.key = key(*h.first);
+            std::push_heap(heads->begin(), heads->end(), c);
+        }
+        position++;
+    }
+
+    typename boost::iterator_reference<Iterator>::type dereference() const
+    {
+        return *heads->front().first;
+    }
+};
+
+// Iterates the elements of the sources, one source after the other, from
+// iterators to them that are kept in a shared vector
+template<class Iterator>
+struct source_element_iterator
+: boost::iterator_facade
+<
+    source_element_iterator<Iterator>,
+    typename boost::iterator_value<Iterator>::type,
+    boost::random_access_traversal_tag,
+    typename boost::iterator_reference<Iterator>::type
+>
+{
+    std::shared_ptr<const std::vector<Iterator> > elements;
+    std::size_t i;
+
+    source_element_iterator() : i(0)
+    {}
+
+    source_element_iterator(std::shared_ptr<const std::vector<Iterator> > elements, std::size_t i) : elements(elements), i(i)
+    {}
+
+    typename boost::iterator_reference<Iterator>::type dereference() const
+    {
+        return *(*elements)[i];
+    }
+
+    bool equal(const source_element_iterator& other) const
+    {
+        return i == other.i;
+    }
+
+    void increment()
+    {
+        i++;
+    }
+
+    void decrement()
+    {
+        i--;
+    }
+
+    void advance(std::ptrdiff_t n)
+    {
+        i += n;
+    }
+
+    std::ptrdiff_t distance_to(const source_element_iterator& other) const
+    {
+        return std::ptrdiff_t(other.i) - std::ptrdiff_t(i);
+    }
+};
+
+}
+
+template<class Iterator, class Key>
+struct merged_range
+{
+    typedef detail::merge_iterator<Iterator, Key> iterator;
+    typedef iterator const_iterator;
+    typedef typename iterator::key_type key_type;
+
+    std::vector<std::pair<Iterator, Iterator> > sources;
+    Key key;
+
+    merged_range(std::vector<std::pair<Iterator, Iterator> > sources, Key key)
+    : sources(std::move(sources)), key(key)
+    {}
+
+    // Returns a range ordered by another key
+    template<class NextKey>
+    ordered_range<detail::source_element_iterator<Iterator>, NextKey> then(NextKey next_key) const
+    {
+        typedef detail::source_element_iterator<Iterator> element_iterator;
+        std::shared_ptr<std::vector<Iterator> > elements = std::make_shared<std::vector<Iterator> >();
+        for(std::size_t i = 0; i < sources.size(); i++)
+        {
+            for(Iterator it = sources[i].first; it != sources[i].second; ++it) elements->push_back(it);
+        }
+        return ordered_range<element_iterator, NextKey>(element_iterator(elements, 0), element_iterator(elements, elements->size()), next_key);
+    }
+
+    iterator begin() const
+    {
+        return iterator(sources, key);
+    }
+
+    iterator end() const
+    {
+        return iterator();
+    }
+};
+
+template<class Iterator, class Key>
+struct is_bindable_range<merged_range<Iterator, Key> >
+: boost::mpl::bool_<true>
+{};
+
+template<class Iterator, class Key>
+merged_range<Iterator, Key> make_merged_range(std::vector<std::pair<Iterator, Iterator> > sources, Key key)
+{
+    return merged_range<Iterator, Key>(std::move(sources), key);
+}
+
+}
+
+#endif
@@ -10,60 +10,568 @@
 
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
+#include <linq/extensions/detail/radix_sort.h>
+#include <boost/iterator/transform_iterator.hpp>
+#include <boost/optional.hpp>
 #include <boost/range.hpp>
 #include <linq/utility.h>
 #include <linq/traits.h>
-#include <set>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef LINQ_SORT_RUN_MIN
+#define LINQ_SORT_RUN_MIN 32
+#endif
 
 namespace linq { 
 
-template<class Iterator, class Compare>
+//
+// ordered_range
+//
+// The ordered range computes the key of each element once, and then sorts
+// the keys together with iterators to the elements of the source, instead of
+// copies of the elements. The sort is stable, so equal elements keep the
+// order of the source. Iterating the range dereferences the sorted iterators.
+//
+// The key is a function object that returns the key of an element, and has a
+// `less(x, y)` member function that compares two keys.
+//
+// When the keys are integers or floating point numbers, including the keys
+// from then_by, the elements are sorted with a stable LSD radix sort instead of a
+// comparison sort.
+//
+// The natural runs of the input are found first. When the input is already
+// sorted, or is made of runs that are LINQ_SORT_RUN_MIN (32) elements long on
+// average, the runs are merged instead, so a sorted input is only checked.
+//
+// When only the first k elements are needed, because of a take, first or
+// element_at downstream, the range keeps a bounded heap of the k smallest
+// elements instead of sorting everything, which takes O(n log k) time and
+// O(k) memory.
+//
+// The sort is lazy, so it happens the first time the range is iterated, and
+// the sorted records are cached in the range. So the same ordered range must
+// not be iterated from several threads at once, unless it has been iterated
+// once before. Each thread can build its own ordered range instead.
+//
+namespace detail {
+
+struct ascending
+{
+    template<class T>
+    bool operator()(const T& x, const T& y) const
+    {
+        return x < y;
+    }
+};
+
+struct descending
+{
+    template<class T>
+    bool operator()(const T& x, const T& y) const
+    {
+        return x > y;
+    }
+};
+
+template<class Selector, class Direction>
+struct order_key
+{
+    Selector s;
+    Direction d;
+
+    // The key is default constructible, so it can be kept in an iterator
+    order_key()
+    {}
+
+    order_key(Selector s, Direction d) : s(s), d(d)
+    {}
+
+    template<class T>
+    typename std::decay<decltype(std::declval<const Selector&>()(std::declval<const T&>()))>::type
+    operator()(const T& x) const
+    {
+        return s(x);
+    }
+
+    template<class K>
+    bool less(const K& x, const K& y) const
+    {
+        return d(x, y);
+    }
+};
+
+template<class Selector, class Direction>
+order_key<Selector, Direction> make_order_key(Selector s, Direction d)
+{
+    return order_key<Selector, Direction>(s, d);
+}
+
+template<std::size_t... I>
+struct index_sequence
+{};
+
+template<std::size_t N, std::size_t... I>
+struct make_index_sequence
+: make_index_sequence<N - 1, N - 1, I...>
+{};
+
+template<std::size_t... I>
+struct make_index_sequence<0, I...>
+{
+    typedef index_sequence<I...> type;
+};
+
+// The ordering is the list of keys from order_by and each then_by. The keys
+// of an element are computed into a tuple, and two tuples are compared key by
+// key, stopping at the first key that differs.
+template<class... Keys>
+struct ordering
+{
+    std::tuple<Keys...> keys;
+
+    ordering()
+    {}
+
+    ordering(std::tuple<Keys...> keys) : keys(keys)
+    {}
+
+    template<class T>
+    struct result
+    {
+        typedef std::tuple<decltype(std::declval<const Keys&>()(std::declval<const T&>()))...> type;
+    };
+
+    template<class T, std::size_t... I>
+    typename result<T>::type make_keys(const T& x, index_sequence<I...>) const
+    {
+        return typename result<T>::type(std::get<I>(keys)(x)...);
+    }
+
+    template<class T>
+    typename result<T>::type operator()(const T& x) const
+    {
+        return this->make_keys(x, typename make_index_sequence<sizeof...(Keys)>::type());
+    }
+
+    template<std::size_t I, class K>
+    bool less_from(const K&, const K&, std::true_type) const
+    {
+        return false;
+    }
+
+    template<std::size_t I, class K>
+    bool less_from(const K& x, const K& y, std::false_type) const
+    {
+        if (std::get<I>(keys).less(std::get<I>(x), std::get<I>(y))) return true;
+        if (std::get<I>(keys).less(std::get<I>(y), std::get<I>(x))) return false;
+        return this->less_from<I + 1>(x, y, std::integral_constant<bool, I + 1 == sizeof...(Keys)>());
+    }
+
+    template<class K>
+    bool less(const K& x, const K& y) const
+    {
+        return this->less_from<0>(x, y, std::false_type());
+    }
+
+    // Returns the ordering with another key at the end
+    template<class Key>
+    ordering<Keys..., Key> then(Key key) const
+    {
+        return ordering<Keys..., Key>(std::tuple_cat(keys, std::make_tuple(key)));
+    }
+};
+
+template<class Key>
+ordering<Key> make_ordering(Key key)
+{
+    return ordering<Key>(std::make_tuple(key));
+}
+
+template<class Iterator>
+struct dereference
+{
+    typedef typename boost::iterator_reference<Iterator>::type result_type;
+
+    template<class T>
+    result_type operator()(const T& x) const
+    {
+        return *x.second;
+    }
+};
+
+template<class Key>
+struct key_compare
+{
+    Key key;
+
+    key_compare(Key key) : key(key)
+    {}
+
+    template<class T>
+    bool operator()(const T& x, const T& y) const
+    {
+        return key.less(x.first, y.first);
+    }
+};
+
+// Compares the elements by their key and then by their position in the
+// source, which keeps the selection of the top elements stable
+template<class Key>
+struct rank_compare
+{
+    Key key;
+
+    rank_compare(Key key) : key(key)
+    {}
+
+    template<class T>
+    bool operator()(const T& x, const T& y) const
+    {
+        if (key.less(x.first.first, y.first.first)) return true;
+        if (key.less(y.first.first, x.first.first)) return false;
+        return x.second < y.second;
+    }
+};
+
+// The keys that can be radix sorted
+template<class Key, class T>
+struct is_radix_key
+: boost::mpl::bool_<false>
+{};
+
+template<class Selector, class Direction, class T>
+struct is_radix_key<order_key<Selector, Direction>, T>
+: is_radix_type<T>
+{};
+
+template<bool... B>
+struct bool_list
+{};
+
+template<class... Keys, class... T>
+struct is_radix_key<ordering<Keys...>, std::tuple<T...> >
+: boost::mpl::bool_<std::is_same
+<
+    bool_list<true, is_radix_key<Keys, T>::value...>,
+    bool_list<is_radix_key<Keys, T>::value..., true>
+>::value>
+{};
+
+struct get_record_key
+{
+    template<class T>
+    auto operator()(const T& x) const -> decltype((x.first))
+    {
+        return x.first;
+    }
+};
+
+template<std::size_t I, class Get>
+struct get_element
+{
+    Get get;
+
+    get_element(Get get) : get(get)
+    {}
+
+    template<class T>
+    auto operator()(const T& x) const -> decltype(std::get<I>(std::declval<const Get&>()(x)))
+    {
+        return std::get<I>(get(x));
+    }
+};
+
+template<class Get>
+struct radix_projection
+{
+    Get get;
+    bool descending;
+
+    radix_projection(Get get, bool descending) : get(get), descending(descending)
+    {}
+
+    template<class T>
+    auto operator()(const T& x) const -> decltype(radix_map(std::declval<const Get&>()(x), true))
+    {
+        return radix_map(get(x), descending);
+    }
+};
+
+// Sorts by the last key first, so the earlier keys end up more significant
+template<class Selector, class Direction, class Iterator, class Get>
+void radix_sort_key(const order_key<Selector, Direction>&, Iterator first, Iterator last, Iterator buffer, Get get)
+{
+    radix_sort_by(first, last, buffer, radix_projection<Get>(get, std::is_same<Direction, descending>::value));
+}
+
+template<std::size_t I, class Ordering, class Iterator, class Get>
+void radix_sort_keys(const Ordering&, Iterator, Iterator, Iterator, Get, std::true_type)
+{}
+
+template<std::size_t I, class Ordering, class Iterator, class Get>
+void radix_sort_keys(const Ordering& o, Iterator first, Iterator last, Iterator buffer, Get get, std::false_type)
+{
+    radix_sort_key(std::get<I - 1>(o.keys), first, last, buffer, get_element<I - 1, Get>(get));
+    radix_sort_keys<I - 1>(o, first, last, buffer, get, std::integral_constant<bool, I - 1 == 0>());
+}
+
+template<class... Keys, class Iterator, class Get>
+void radix_sort_key(const ordering<Keys...>& o, Iterator first, Iterator last, Iterator buffer, Get get)
+{
+    radix_sort_keys<sizeof...(Keys)>(o, first, last, buffer, get, std::false_type());
+}
+
+// Finds the natural runs of the records in [first, last), which are the
+// bounds of the runs with the end last. A strictly descending run is reversed
+// in place, which is still stable since it has no equal keys. Returns false
+// as soon as there are more than max_runs runs.
+template<class Key, class Iterator>
+bool find_runs(Iterator first, Iterator last, const Key& key, std::size_t max_runs, std::vector<Iterator>& bounds)
+{
+    bounds.push_back(first);
+    Iterator it = first;
+    while (it != last)
+    {
+        if (bounds.size() > max_runs) return false;
+        Iterator start = it++;
+        if (it != last and key.less(it->first, std::prev(it)->first))
+        {
+            while (++it != last and key.less(it->first, std::prev(it)->first));
+            std::reverse(start, it);
+        }
+        else while (it != last and !key.less(it->first, std::prev(it)->first)) ++it;
+        bounds.push_back(it);
+    }
+    return true;
+}
+
+// Sorts the records by merging their natural runs, when the runs are long
+// enough on average. So a sorted input takes one pass, and an input made of a
+// few sorted parts takes a pass for each merge. Returns false, after at most
+// a few passes, when the runs are too short.
+template<class Key, class Iterator>
+bool sort_runs(Iterator first, Iterator last, const Key& key)
+{
+    std::vector<Iterator> bounds;
+    if (!find_runs(first, last, key, (last - first) / LINQ_SORT_RUN_MIN + 1, bounds)) return false;
+    key_compare<Key> c(key);
+    while (bounds.size() > 2)
+    {
+        std::vector<Iterator> merged;
+        for(std::size_t i = 0; i + 1 < bounds.size(); i += 2)
+        {
+            merged.push_back(bounds[i]);
+            if (i + 2 < bounds.size()) std::inplace_merge(bounds[i], bounds[i + 1], bounds[i + 2], c);
+        }
+        merged.push_back(last);
+        bounds.swap(merged);
+    }
+    return true;
+}
+
+// Sorts the records in [first, last) by their key
+template<class Key, class Iterator>
+void sort_by_key(Iterator first, Iterator last, const Key& key, boost::mpl::bool_<false>)
+{
+    std::stable_sort(first, last, key_compare<Key>(key));
+}
+
+template<class Key, class Iterator>
+void sort_by_key(Iterator first, Iterator last, const Key& key, boost::mpl::bool_<true>)
+{
+    if (std::size_t(last - first) < LINQ_RADIX_SORT_MIN) sort_by_key(first, last, key, boost::mpl::bool_<false>());
+    else
+    {
+        std::vector<typename std::iterator_traits<Iterator>::value_type> buffer(last - first);
+        radix_sort_key(key, first, last, buffer.begin(), get_record_key());
+    }
+}
+
+template<class Key, class Iterator>
+void sort_by_key(Iterator first, Iterator last, const Key& key)
+{
+    typedef typename std::iterator_traits<Iterator>::value_type record;
+    if (sort_runs(first, last, key)) return;
+    sort_by_key(first, last, key, is_radix_key<Key, typename record::first_type>());
+}
+
+// The policy decides how the records are sorted
+template<class T, class Key>
+void sort_records(const sequential_policy&, std::vector<T>& records, const Key& key)
+{
+    sort_by_key(records.begin(), records.end(), key);
+}
+
+}
+
+template<class Iterator, class Key, class Policy = detail::sequential_policy>
 struct ordered_range
 {
-    typedef std::multiset<typename boost::iterator_value<Iterator>::type, Compare> sorted_set;
-    Compare c;
+    typedef typename std::decay<decltype(std::declval<const Key&>()(*std::declval<Iterator>()))>::type key_type;
+    typedef std::vector<std::pair<key_type, Iterator> > sorted_vector;
+    Key key;
     Iterator first, last;
-    sorted_set sorted;
+    Policy policy;
+    // Sorted by the first call to begin or end, which isn't synchronized
+    mutable sorted_vector sorted;
+    mutable bool is_sorted;
+    std::size_t limit;
 
-    typedef typename sorted_set::iterator iterator;
-    typedef typename sorted_set::const_iterator const_iterator;
+    typedef boost::transform_iterator
+    <
+        detail::dereference<Iterator>,
+        typename sorted_vector::const_iterator,
+        typename boost::iterator_reference<Iterator>::type,
+        typename boost::iterator_value<Iterator>::type
+    > iterator;
+    typedef iterator const_iterator;
 
-    ordered_range(Iterator first, Iterator last)
-    : first(first), last(last)
+    ordered_range(Iterator first, Iterator last, Key key, Policy policy = Policy())
+    : key(key), first(first), last(last), policy(policy), is_sorted(false), limit(std::numeric_limits<std::size_t>::max())
     {}
 
-    ordered_range(Iterator first, Iterator last, Compare c)
-    : first(first), last(last), c(c)
-    {}
+    // Returns a range ordered by another key, with the same policy. The limit
+    // from take is kept, so it has the first elements by all of the keys.
+    template<class NextKey>
+    ordered_range<Iterator, NextKey, Policy> then(NextKey next_key) const
+    {
+        ordered_range<Iterator, NextKey, Policy> result(first, last, next_key, policy);
+        result.limit = limit;
+        return result;
+    }
+
+    void select_top() const
+    {
+        typedef std::pair<std::pair<key_type, Iterator>, std::size_t> ranked;
+        detail::rank_compare<Key> c(key);
+        std::vector<ranked> heap;
+        std::size_t position = 0;
+        for(Iterator it = first; it != last and limit > 0; ++it, ++position)
+        {
+            ranked x(std::make_pair(key(*it), it), position);
+            if (heap.size() < limit)
+            {
+                heap.push_back(std::move(x));
+                std::push_heap(heap.begin(), heap.end(), c);
+            }
+            else if (c(x, heap.front()))
+            {
+                std::pop_heap(heap.begin(), heap.end(), c);
+                heap.back() = std::move(x);
+                std::push_heap(heap.begin(), heap.end(), c);
+            }
+        }
+        std::sort_heap(heap.begin(), heap.end(), c);
+        for(std::size_t i = 0; i < heap.size(); i++) sorted.push_back(std::move(heap[i].first));
+    }
+
+    void sort() const
+    {
+        if (is_sorted) return;
+        // The heap only pays off when a small part of the range is selected
+        if (limit != std::numeric_limits<std::size_t>::max() and limit < std::size_t(std::distance(first, last)) / 8) this->select_top();
+        else
+        {
+            for(Iterator it = first; it != last; ++it) sorted.push_back(std::make_pair(key(*it), it));
+            sort_records(policy, sorted, key);
+            if (sorted.size() > limit) sorted.erase(sorted.begin() + limit, sorted.end());
+        }
+        is_sorted = true;
+    }
 
-    void sort()
+    // Returns a range of the first n elements
+    ordered_range take(long n) const
     {
-        if (sorted.empty()) sorted = sorted_set(first, last, c);
+        ordered_range result(first, last, key, policy);
+        result.limit = std::min<std::size_t>(limit, n > 0 ? n : 0);
+        return result;
     }
 
-    iterator begin()
+    // Returns an iterator to the last element in the source that has the
+    // greatest key, which is the last element of a stable sort. Returns the
+    // end of the source if the range is empty.
+    Iterator last_element() const
+    {
+        if (is_sorted or limit != std::numeric_limits<std::size_t>::max())
+        {
+            this->sort();
+            return sorted.empty() ? last : sorted.back().second;
+        }
+        Iterator result = last;
+        boost::optional<key_type> result_key = boost::none;
+        for(Iterator it = first; it != last; ++it)
+        {
+            key_type k = key(*it);
+            if (!result_key or !key.less(k, *result_key))
+            {
+                result = it;
+                result_key = std::move(k);
+            }
+        }
+        return result;
+    }
+
+    iterator begin() const
     {
         this->sort(); 
-        return sorted.begin();
+        return iterator(sorted.begin(), detail::dereference<Iterator>());
     }
 
-    iterator end()
+    iterator end() const
     {
         this->sort(); 
-        return sorted.end();
+        return iterator(sorted.end(), detail::dereference<Iterator>());
     }
 
 };
 
-template<class Iterator, class Compare>
-struct is_bindable_range<ordered_range<Iterator, Compare> >
+template<class Iterator, class Key, class Policy>
+struct is_bindable_range<ordered_range<Iterator, Key, Policy> >
+: boost::mpl::bool_<true>
+{};
+
+template<class T>
+struct is_ordered_range
+: boost::mpl::bool_<false>
+{};
+
+template<class Iterator, class Key, class Policy>
+struct is_ordered_range<ordered_range<Iterator, Key, Policy> >
 : boost::mpl::bool_<true>
 {};
 
-template<class Iterator, class Compare>
-ordered_range<Iterator, function_object<Compare> > make_ordered_range(Iterator first, Iterator last, Compare c)
+template<class T>
+struct is_ordered_range<const T>
+: is_ordered_range<T>
+{};
+
+template<class T>
+struct is_ordered_range<T&>
+: is_ordered_range<T>
+{};
+
+template<class T>
+struct is_ordered_range<T&&>
+: is_ordered_range<T>
+{};
+
+template<class Iterator, class Key>
+ordered_range<Iterator, Key> make_ordered_range(Iterator first, Iterator last, Key key)
+{
+    return ordered_range<Iterator, Key>(first, last, key);
+}
+
+template<class Iterator, class Key, class Policy>
+ordered_range<Iterator, Key, Policy> make_ordered_range(Iterator first, Iterator last, Key key, Policy policy)
 {
-    return ordered_range<Iterator, function_object<Compare> >(first, last, function_object<Compare>(c));
+    return ordered_range<Iterator, Key, Policy>(first, last, key, policy);
 }
 
 }
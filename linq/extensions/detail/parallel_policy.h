@@ -0,0 +1,223 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    parallel_policy.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_PARALLEL_POLICY_H
+#define LINQ_GUARD_DETAIL_PARALLEL_POLICY_H
+
+#include <linq/extensions/detail/fused_range.h>
+#include <linq/extensions/detail/ordered_range.h>
+#include <linq/thread_pool.h>
+#include <boost/iterator/iterator_categories.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#ifndef LINQ_PARALLEL_MIN_CHUNK
+#define LINQ_PARALLEL_MIN_CHUNK 1024
+#endif
+
+#ifndef LINQ_PARALLEL_CHUNKS_PER_THREAD
+#define LINQ_PARALLEL_CHUNKS_PER_THREAD 8
+#endif
+
+#ifndef LINQ_PARALLEL_SORT_MIN
+#define LINQ_PARALLEL_SORT_MIN 65536
+#endif
+
+namespace linq {
+
+namespace detail {
+
+// Splits a random access source into chunks, which are run on the executor.
+// Each chunk is pushed into its own partial sink, which is created with
+// sink.split(), and then the partials are joined back into the sink in order
+// with sink.join(partial). There are several chunks for each thread, so the
+// threads that finish their chunks early can steal the rest of the work.
+// Other sources are pushed sequentially.
+template<class Executor = thread_pool>
+struct parallel_policy
+{
+    std::shared_ptr<Executor> owner;
+    Executor * executor;
+
+    parallel_policy()
+    : executor(&thread_pool::instance())
+    {}
+
+    parallel_policy(Executor& executor)
+    : executor(&executor)
+    {}
+
+    parallel_policy(std::shared_ptr<Executor> owner)
+    : owner(owner), executor(owner.get())
+    {}
+
+    // Stops every chunk once the sink of one chunk stops
+    template<class Sink>
+    struct stopping_sink
+    {
+        Sink * sink;
+        std::atomic<bool> * stopped;
+
+        stopping_sink(Sink& sink, std::atomic<bool>& stopped)
+        : sink(&sink), stopped(&stopped)
+        {}
+
+        template<class T>
+        bool operator()(T && x) const
+        {
+            if (stopped->load(std::memory_order_relaxed)) return false;
+            if ((*sink)(std::forward<T>(x))) return true;
+            *stopped = true;
+            return false;
+        }
+    };
+
+    template<class Iterator, class Stage, class Sink>
+    static void run_chunk(Iterator first, Iterator last, const Stage& stage, Sink& sink, std::atomic<bool>& stopped)
+    {
+        stage.push(first, last, stopping_sink<Sink>(sink, stopped));
+    }
+
+    template<class Iterator, class Stage, class Sink>
+    bool run(Iterator first, Iterator last, const Stage& stage, Sink& sink, boost::incrementable_traversal_tag) const
+    {
+        return sequential_policy().run(first, last, stage, sink);
+    }
+
+    template<class Iterator, class Stage, class Sink>
+    bool run(Iterator first, Iterator last, const Stage& stage, Sink& sink, boost::random_access_traversal_tag) const
+    {
+        typedef decltype(sink.split()) partial_sink;
+        std::size_t n = last - first;
+        std::size_t chunks = std::min<std::size_t>(executor_concurrency(*executor) * LINQ_PARALLEL_CHUNKS_PER_THREAD, n / LINQ_PARALLEL_MIN_CHUNK);
+        if (chunks < 2) return sequential_policy().run(first, last, stage, sink);
+
+        std::atomic<bool> stopped(false);
+        std::vector<partial_sink> partials;
+        for(std::size_t i = 1; i < chunks; i++) partials.push_back(sink.split());
+        linq::parallel_for(*executor, 0, chunks, [&](std::size_t i)
+        {
+            Iterator chunk_first = first + n * i / chunks;
+            Iterator chunk_last = first + n * (i + 1) / chunks;
+            if (i == 0) run_chunk(chunk_first, chunk_last, stage, sink, stopped);
+            else run_chunk(chunk_first, chunk_last, stage, partials[i - 1], stopped);
+        });
+        for(std::size_t i = 0; i < partials.size(); i++) sink.join(partials[i]);
+        return !stopped;
+    }
+
+    template<class Iterator, class Stage, class Sink>
+    bool run(Iterator first, Iterator last, const Stage& stage, Sink& sink) const
+    {
+        return this->run(first, last, stage, sink, typename boost::iterator_traversal<Iterator>::type());
+    }
+};
+
+// Returns how many of the first k elements of the stable merge of a and b
+// come from a
+template<class Iterator, class Compare>
+std::size_t merge_split(Iterator a, std::size_t n, Iterator b, std::size_t m, std::size_t k, Compare c)
+{
+    std::size_t lo = k > m ? k - m : 0;
+    std::size_t hi = std::min(k, n);
+    while (lo < hi)
+    {
+        std::size_t i = lo + (hi - lo) / 2;
+        std::size_t j = k - i;
+        if (j > 0 and !c(b[j - 1], a[i])) lo = i + 1;
+        else hi = i;
+    }
+    return lo;
+}
+
+// Sorts a chunk of the records for each thread, and then merges pairs of
+// sorted runs until there is only one left. Each merge is split into pieces
+// of the output, which are merged in parallel too. The chunks are sorted
+// with a stable sort and the runs on the left win ties, so the whole sort is
+// stable.
+template<class Executor, class T, class Key>
+void sort_records(const parallel_policy<Executor>& policy, std::vector<T>& records, const Key& key)
+{
+    const std::size_t n = records.size();
+    const std::size_t threads = executor_concurrency(*policy.executor);
+    if (n < LINQ_PARALLEL_SORT_MIN or threads < 2)
+    {
+        sort_by_key(records.begin(), records.end(), key);
+        return;
+    }
+
+    // An input that is already sorted is only checked
+    std::vector<typename std::vector<T>::iterator> runs;
+    if (find_runs(records.begin(), records.end(), key, 1, runs)) return;
+
+    std::vector<std::size_t> bounds;
+    for(std::size_t i = 0; i <= threads; i++) bounds.push_back(n * i / threads);
+    linq::parallel_for(*policy.executor, 0, threads, [&](std::size_t i)
+    {
+        sort_by_key(records.begin() + bounds[i], records.begin() + bounds[i + 1], key);
+    });
+
+    key_compare<Key> c(key);
+    std::vector<T> buffer(n);
+    std::vector<T> * from = &records;
+    std::vector<T> * to = &buffer;
+    while (bounds.size() > 2)
+    {
+        const std::size_t runs = bounds.size() - 1;
+        const std::size_t pairs = (runs + 1) / 2;
+        const std::size_t pieces = std::max<std::size_t>(1, threads / pairs);
+        // The splits are found before merging, since the merges move the
+        // elements out of the runs
+        std::vector<std::size_t> splits(pairs * (pieces + 1));
+        for(std::size_t p = 0; p < pairs; p++)
+        {
+            std::size_t r = 2 * p;
+            std::size_t a = bounds[r];
+            std::size_t b = bounds[r + 1];
+            std::size_t e = r + 1 < runs ? bounds[r + 2] : b;
+            for(std::size_t i = 0; i <= pieces; i++)
+            {
+                std::size_t k = (e - a) * i / pieces;
+                splits[p * (pieces + 1) + i] = merge_split(from->begin() + a, b - a, from->begin() + b, e - b, k, c);
+            }
+        }
+        linq::parallel_for(*policy.executor, 0, pairs * pieces, [&](std::size_t t)
+        {
+            std::size_t p = t / pieces;
+            std::size_t i = t % pieces;
+            std::size_t r = 2 * p;
+            std::size_t a = bounds[r];
+            std::size_t b = bounds[r + 1];
+            std::size_t e = r + 1 < runs ? bounds[r + 2] : b;
+            std::size_t k0 = (e - a) * i / pieces;
+            std::size_t k1 = (e - a) * (i + 1) / pieces;
+            std::size_t i0 = splits[p * (pieces + 1) + i];
+            std::size_t i1 = splits[p * (pieces + 1) + i + 1];
+            std::merge
+            (
+                std::make_move_iterator(from->begin() + a + i0), std::make_move_iterator(from->begin() + a + i1),
+                std::make_move_iterator(from->begin() + b + (k0 - i0)), std::make_move_iterator(from->begin() + b + (k1 - i1)),
+                to->begin() + a + k0, c
+            );
+        });
+        std::vector<std::size_t> next;
+        for(std::size_t r = 0; r < runs; r += 2) next.push_back(bounds[r]);
+        next.push_back(n);
+        bounds.swap(next);
+        std::swap(from, to);
+    }
+    if (from != &records) records.swap(buffer);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,308 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    partitioned_join.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_PARTITIONED_JOIN_H
+#define LINQ_GUARD_DETAIL_PARTITIONED_JOIN_H
+
+#include <linq/extensions/detail/flat_table.h>
+#include <linq/thread_pool.h>
+#include <boost/functional/hash.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/range.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef LINQ_JOIN_PARTITION_BYTES
+#define LINQ_JOIN_PARTITION_BYTES (256 * 1024)
+#endif
+
+namespace linq {
+
+//
+// partitioned join
+//
+// For joins where the table of the inner range is much bigger than the
+// cache, so nearly every probe misses. Both ranges are split into partitions
+// by the high bits of the hash of their keys, with as many partitions as it
+// takes for the table of each inner partition to fit in
+// LINQ_JOIN_PARTITION_BYTES (256 KB, about the size of L2). Then each
+// partition of the outer range is joined with the same partition of the
+// inner range, on the shared thread_pool, so the probes of a partition stay
+// in the cache.
+//
+// The pairs of the outer and inner rows that match are kept, and put back in
+// the order of the outer range, and then the inner range, so the results are
+// in the same order as the other joins. The rows are kept as iterators, or
+// as copies when the inner range is a temporary.
+//
+namespace detail {
+
+template<class Range, bool ByRef = true, bool RandomAccess = std::is_convertible
+<
+    typename boost::iterator_traversal<typename boost::range_iterator<typename std::remove_reference<Range>::type>::type>::type,
+    boost::random_access_traversal_tag
+>::value>
+struct join_rows
+{
+    typedef typename boost::range_iterator<typename std::remove_reference<Range>::type>::type iterator;
+    typedef typename boost::iterator_reference<iterator>::type reference;
+
+    std::vector<iterator> rows;
+
+    template<class R>
+    join_rows(R && r)
+    {
+        for(iterator it = boost::begin(r); it != boost::end(r); ++it) rows.push_back(it);
+    }
+
+    reference operator[](std::size_t i) const
+    {
+        return *rows[i];
+    }
+
+    std::size_t size() const
+    {
+        return rows.size();
+    }
+};
+
+// With random access, only the first row is kept
+template<class Range>
+struct join_rows<Range, true, true>
+{
+    typedef typename boost::range_iterator<typename std::remove_reference<Range>::type>::type iterator;
+    typedef typename boost::iterator_reference<iterator>::type reference;
+
+    iterator first;
+    std::size_t n;
+
+    template<class R>
+    join_rows(R && r) : first(boost::begin(r)), n(boost::size(r))
+    {}
+
+    reference operator[](std::size_t i) const
+    {
+        return first[i];
+    }
+
+    std::size_t size() const
+    {
+        return n;
+    }
+};
+
+template<class Range, bool RandomAccess>
+struct join_rows<Range, false, RandomAccess>
+{
+    typedef typename boost::range_value<typename std::remove_reference<Range>::type>::type value_type;
+    typedef const value_type& reference;
+
+    std::vector<value_type> rows;
+
+    template<class R>
+    join_rows(R && r) : rows(boost::begin(r), boost::end(r))
+    {}
+
+    reference operator[](std::size_t i) const
+    {
+        return rows[i];
+    }
+
+    std::size_t size() const
+    {
+        return rows.size();
+    }
+};
+
+// Splits the rows into 2^bits partitions by the hash of their key. The keys
+// are returned in the order of the partitions, with the index of their row
+// next to them in index, and the rows of partition p are in
+// [offsets[p], offsets[p + 1]), in the order of the rows.
+template<class Key, class Rows, class KeySelector>
+void radix_partition(const Rows& rows, KeySelector& ks, int bits, std::vector<Key>& keys, std::vector<std::size_t>& index, std::vector<std::size_t>& offsets)
+{
+    boost::hash<Key> hasher;
+    std::vector<Key> unordered;
+    std::vector<std::size_t> parts;
+    unordered.reserve(rows.size());
+    parts.reserve(rows.size());
+    for(std::size_t i = 0; i < rows.size(); i++)
+    {
+        unordered.push_back(Key(ks(rows[i])));
+        parts.push_back(bits == 0 ? 0 : std::size_t(flat_mix(hasher(unordered.back())) >> (64 - bits)));
+    }
+    index = group_order(parts, std::size_t(1) << bits, offsets);
+    keys.reserve(index.size());
+    for(std::size_t i = 0; i < index.size(); i++) keys.push_back(std::move(unordered[index[i]]));
+}
+
+// The number of bits of the hash that gives partitions of the inner range
+// with tables that fit in LINQ_JOIN_PARTITION_BYTES
+template<class Key>
+int join_partition_bits(std::size_t n)
+{
+    const std::size_t row_bytes = sizeof(Key) + 3 * sizeof(std::size_t);
+    int bits = 0;
+    while (bits < 14 and (n * row_bytes >> bits) > LINQ_JOIN_PARTITION_BYTES) bits++;
+    return bits;
+}
+
+template<class OuterRows, class InnerRows>
+struct partitioned_join_result
+{
+    OuterRows outer;
+    InnerRows inner;
+    // The index of the outer and inner row of each result
+    std::vector<std::pair<std::size_t, std::size_t> > pairs;
+
+    template<class Outer, class Inner>
+    partitioned_join_result(Outer && o, Inner && i)
+    : outer(std::forward<Outer>(o)), inner(std::forward<Inner>(i))
+    {}
+
+    template<class Key, class OuterKeySelector, class InnerKeySelector>
+    void join(OuterKeySelector os, InnerKeySelector is)
+    {
+        const int bits = join_partition_bits<Key>(inner.size());
+        const std::size_t partitions = std::size_t(1) << bits;
+        std::vector<Key> inner_keys, outer_keys;
+        std::vector<std::size_t> inner_index, outer_index, inner_offsets, outer_offsets;
+        radix_partition(inner, is, bits, inner_keys, inner_index, inner_offsets);
+        radix_partition(outer, os, bits, outer_keys, outer_index, outer_offsets);
+
+        std::vector<std::vector<std::pair<std::size_t, std::size_t> > > matches(partitions);
+        linq::parallel_for(thread_pool::instance(), 0, partitions, [&](std::size_t p)
+        {
+            const std::size_t first = inner_offsets[p];
+            flat_table<Key> table;
+            table.reserve(inner_offsets[p + 1] - first);
+            std::vector<std::size_t> ids;
+            for(std::size_t i = first; i < inner_offsets[p + 1]; i++) ids.push_back(table.insert(std::move(inner_keys[i])).first);
+            std::vector<std::size_t> groups;
+            std::vector<std::size_t> order = group_order(ids, table.size(), groups);
+            for(std::size_t j = outer_offsets[p]; j < outer_offsets[p + 1]; j++)
+            {
+                std::size_t g = table.find(outer_keys[j]);
+                if (g == table.npos) continue;
+                for(std::size_t k = groups[g]; k < groups[g + 1]; k++)
+                    matches[p].push_back(std::make_pair(outer_index[j], inner_index[first + order[k]]));
+            }
+        });
+
+        // Each outer row is in one partition, where its matches are in the
+        // order of the inner range, so they are only put in the order of the
+        // outer rows
+        std::vector<std::size_t> next(outer.size() + 1, 0);
+        for(std::size_t p = 0; p < partitions; p++)
+            for(std::size_t i = 0; i < matches[p].size(); i++) next[matches[p][i].first + 1]++;
+        for(std::size_t i = 0; i < outer.size(); i++) next[i + 1] += next[i];
+        pairs.resize(next.back());
+        for(std::size_t p = 0; p < partitions; p++)
+            for(std::size_t i = 0; i < matches[p].size(); i++) pairs[next[matches[p][i].first]++] = matches[p][i];
+    }
+};
+
+template<class Result, class ResultSelector>
+struct partitioned_join_iterator_types
+{
+    typedef decltype(std::declval<const ResultSelector&>()
+    (
+        std::declval<const Result&>().outer[0],
+        std::declval<const Result&>().inner[0]
+    )) reference;
+    typedef typename std::decay<reference>::type value_type;
+};
+
+template<class Result, class ResultSelector>
+struct partitioned_join_iterator
+: boost::iterator_facade
+<
+    partitioned_join_iterator<Result, ResultSelector>,
+    typename partitioned_join_iterator_types<Result, ResultSelector>::value_type,
+    boost::random_access_traversal_tag,
+    typename partitioned_join_iterator_types<Result, ResultSelector>::reference
+>
+{
+    typedef typename partitioned_join_iterator_types<Result, ResultSelector>::reference reference;
+
+    std::shared_ptr<const Result> result;
+    ResultSelector rs;
+    std::size_t i;
+
+    partitioned_join_iterator() : i(0)
+    {}
+
+    partitioned_join_iterator(std::shared_ptr<const Result> result, ResultSelector rs, std::size_t i)
+    : result(result), rs(rs), i(i)
+    {}
+
+    reference dereference() const
+    {
+        const std::pair<std::size_t, std::size_t>& p = result->pairs[i];
+        return rs(result->outer[p.first], result->inner[p.second]);
+    }
+
+    bool equal(const partitioned_join_iterator& other) const
+    {
+        return i == other.i;
+    }
+
+    void increment()
+    {
+        i++;
+    }
+
+    void decrement()
+    {
+        i--;
+    }
+
+    void advance(std::ptrdiff_t n)
+    {
+        i += n;
+    }
+
+    std::ptrdiff_t distance_to(const partitioned_join_iterator& other) const
+    {
+        return std::ptrdiff_t(other.i) - std::ptrdiff_t(i);
+    }
+};
+
+template<class Outer, class Inner, class InnerKeySelector, class ResultSelector>
+struct partitioned_join_types
+{
+    typedef typename boost::range_reference<typename std::remove_reference<Inner>::type>::type inner_reference;
+    typedef typename std::decay<decltype(std::declval<InnerKeySelector>()(std::declval<inner_reference>()))>::type key_type;
+    typedef partitioned_join_result<join_rows<Outer>, join_rows<Inner, std::is_lvalue_reference<Inner>::value> > result;
+    typedef partitioned_join_iterator<result, ResultSelector> iterator;
+    typedef boost::iterator_range<iterator> type;
+};
+
+template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+typename partitioned_join_types<Outer, Inner, InnerKeySelector, ResultSelector>::type
+make_partitioned_join_range(Outer && outer, Inner && inner, OuterKeySelector os, InnerKeySelector is, ResultSelector rs)
+{
+    typedef partitioned_join_types<Outer, Inner, InnerKeySelector, ResultSelector> types;
+    typedef typename types::iterator iterator;
+    std::shared_ptr<typename types::result> result = std::make_shared<typename types::result>(outer, std::forward<Inner>(inner));
+    result->template join<typename types::key_type>(os, is);
+    return boost::make_iterator_range
+    (
+        iterator(result, rs, 0),
+        iterator(result, rs, result->pairs.size())
+    );
+}
+
+}
+
+}
+
+#endif
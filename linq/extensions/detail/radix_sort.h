@@ -0,0 +1,140 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    radix_sort.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_RADIX_SORT_H
+#define LINQ_GUARD_DETAIL_RADIX_SORT_H
+
+#include <boost/mpl/bool.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef LINQ_RADIX_SORT_MIN
+#define LINQ_RADIX_SORT_MIN 512
+#endif
+
+namespace linq {
+
+namespace detail {
+
+// Integral and floating point keys, of up to 64 bits, can be sorted by the
+// bytes of an unsigned integer that has the same order as the key
+template<class T>
+struct is_radix_type
+: boost::mpl::bool_<std::is_arithmetic<T>::value and sizeof(T) <= 8 and
+    (std::is_integral<T>::value or std::numeric_limits<T>::is_iec559)>
+{};
+
+template<std::size_t Size>
+struct radix_unsigned;
+
+template<>
+struct radix_unsigned<1>
+{
+    typedef std::uint8_t type;
+};
+
+template<>
+struct radix_unsigned<2>
+{
+    typedef std::uint16_t type;
+};
+
+template<>
+struct radix_unsigned<4>
+{
+    typedef std::uint32_t type;
+};
+
+template<>
+struct radix_unsigned<8>
+{
+    typedef std::uint64_t type;
+};
+
+template<class T>
+typename radix_unsigned<sizeof(T)>::type radix_bits(T x, boost::mpl::bool_<true>)
+{
+    typedef typename radix_unsigned<sizeof(T)>::type type;
+    const type sign = std::is_signed<T>::value ? type(type(1) << (sizeof(T) * 8 - 1)) : type(0);
+    return static_cast<type>(x) ^ sign;
+}
+
+// Negative floating point numbers have all of their bits flipped, so larger
+// magnitudes come first, and positive numbers just have their sign bit set
+template<class T>
+typename radix_unsigned<sizeof(T)>::type radix_bits(T x, boost::mpl::bool_<false>)
+{
+    typedef typename radix_unsigned<sizeof(T)>::type type;
+    const type sign = type(1) << (sizeof(T) * 8 - 1);
+    // -0.0 is equal to 0.0, so it has to have the same bits
+    if (x == 0) x = 0;
+    type bits;
+    std::memcpy(&bits, &x, sizeof(T));
+    return (bits & sign) ? type(~bits) : type(bits | sign);
+}
+
+// Maps the key to an unsigned integer with the same order. A descending key
+// has its bits flipped, so the sort itself is always ascending.
+template<class T>
+typename radix_unsigned<sizeof(T)>::type radix_map(T x, bool descending)
+{
+    typedef typename radix_unsigned<sizeof(T)>::type type;
+    type bits = radix_bits(x, boost::mpl::bool_<std::is_integral<T>::value>());
+    return descending ? type(~bits) : bits;
+}
+
+// A stable LSD radix sort of the records in [first, last), by the unsigned
+// integer that the projection returns, one byte at a time. The buffer must
+// have room for as many records. The counts for every byte are computed in
+// one pass, and the bytes that are the same for every record are skipped.
+template<class Iterator, class Projection>
+void radix_sort_by(Iterator first, Iterator last, Iterator buffer, Projection p)
+{
+    typedef decltype(p(*first)) type;
+    const std::size_t bytes = sizeof(type);
+    const std::size_t n = last - first;
+    if (n == 0) return;
+    std::vector<std::size_t> counts(bytes * 256, 0);
+    for(std::size_t i = 0; i < n; i++)
+    {
+        type bits = p(first[i]);
+        for(std::size_t b = 0; b < bytes; b++) counts[b * 256 + ((bits >> (b * 8)) & 0xff)]++;
+    }
+    Iterator from = first;
+    Iterator to = buffer;
+    for(std::size_t b = 0; b < bytes; b++)
+    {
+        std::size_t * count = &counts[b * 256];
+        if (count[(p(from[0]) >> (b * 8)) & 0xff] == n) continue;
+        std::size_t offset = 0;
+        for(std::size_t d = 0; d < 256; d++)
+        {
+            std::size_t c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        for(std::size_t i = 0; i < n; i++)
+        {
+            std::size_t d = (p(from[i]) >> (b * 8)) & 0xff;
+            to[count[d]++] = std::move(from[i]);
+        }
+        std::swap(from, to);
+    }
+    if (from != first) std::move(from, from + n, first);
+}
+
+}
+
+}
+
+#endif
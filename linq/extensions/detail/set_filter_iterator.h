@@ -9,7 +9,7 @@
 #define LINQ_GUARD_DETAIL_SET_FILTER_ITERATOR_H
 
 #include <boost/iterator_adaptors.hpp>
-#include <boost/unordered_set.hpp>
+#include <linq/extensions/detail/flat_table.h>
 #include <boost/range.hpp>
 #include <linq/utility.h>
 
@@ -29,7 +29,7 @@ struct set_filter_iterator
     // optimized away via EBO if it is an empty class.
     Predicate p;
     Iterator last;
-    typedef boost::unordered_set<typename boost::iterator_value<Iterator>::type> set_t;
+    typedef flat_set<typename boost::iterator_value<Iterator>::type> set_t;
     set_t set;
 
     typedef boost::iterator_adaptor<set_filter_iterator<Predicate, Iterator>, Iterator, boost::use_default, boost::forward_traversal_tag> super_t;
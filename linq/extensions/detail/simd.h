@@ -0,0 +1,312 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    simd.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_SIMD_H
+#define LINQ_GUARD_DETAIL_SIMD_H
+
+#include <boost/range.hpp>
+#include <boost/mpl/bool.hpp>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+//
+// Vector kernels for sum, min and max over contiguous ranges of int, float and
+// double. On x86 the AVX2 kernels are picked at runtime when the cpu supports
+// them, otherwise the SSE2 kernels are used. On ARM the NEON kernels are
+// used. Everything else uses the scalar kernels. Define LINQ_NO_SIMD to
+// always use the scalar kernels.
+//
+// The kernels add several lanes at once, so the sum of floating point values
+// can differ in the last bits from adding them one after the other.
+//
+#ifndef LINQ_NO_SIMD
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define LINQ_SIMD_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define LINQ_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace linq {
+
+namespace detail {
+
+template<class T>
+struct is_simd_type
+: boost::mpl::bool_<false>
+{};
+
+template<>
+struct is_simd_type<int>
+: boost::mpl::bool_<true>
+{};
+
+template<>
+struct is_simd_type<float>
+: boost::mpl::bool_<true>
+{};
+
+template<>
+struct is_simd_type<double>
+: boost::mpl::bool_<true>
+{};
+
+// Pointers and vector iterators are the contiguous iterators that can be
+// detected portably
+template<class Iterator, class T>
+struct is_contiguous_iterator
+: boost::mpl::bool_
+<
+    std::is_same<Iterator, T*>::value or
+    std::is_same<Iterator, const T*>::value or
+    std::is_same<Iterator, typename std::vector<T>::iterator>::value or
+    std::is_same<Iterator, typename std::vector<T>::const_iterator>::value
+>
+{};
+
+template<class Iterator, class Enable = void>
+struct is_simd_iterator
+: boost::mpl::bool_<false>
+{};
+
+template<class Iterator>
+struct is_simd_iterator<Iterator, typename std::enable_if<is_simd_type<typename boost::iterator_value<Iterator>::type>::value>::type>
+: is_contiguous_iterator<Iterator, typename boost::iterator_value<Iterator>::type>
+{};
+
+template<class Range>
+struct is_simd_range
+: is_simd_iterator<typename boost::range_iterator<typename std::remove_reference<Range>::type>::type>
+{};
+
+namespace simd {
+
+struct sum_op
+{
+    template<class T>
+    static T scalar(T x, T y)
+    {
+        return x + y;
+    }
+};
+
+struct min_op
+{
+    template<class T>
+    static T scalar(T x, T y)
+    {
+        return (y < x) ? y : x;
+    }
+};
+
+struct max_op
+{
+    template<class T>
+    static T scalar(T x, T y)
+    {
+        return (x < y) ? y : x;
+    }
+};
+
+// The kernel keeps four vector accumulators to hide the latency of each
+// operation, and then reduces the lanes and the tail with the scalar op.
+// Requires n > 0.
+#define LINQ_SIMD_REDUCE_KERNEL(attr) \
+template<class Op, class T> \
+attr T reduce(const T * p, std::size_t n) \
+{ \
+    typedef decltype(load(p)) vector_type; \
+    const std::size_t w = sizeof(vector_type) / sizeof(T); \
+    std::size_t i = 0; \
+    T result; \
+    if (n >= 4 * w) \
+    { \
+        vector_type a0 = load(p); \
+        vector_type a1 = load(p + w); \
+        vector_type a2 = load(p + 2 * w); \
+        vector_type a3 = load(p + 3 * w); \
+        for(i = 4 * w; i + 4 * w <= n; i += 4 * w) \
+        { \
+            a0 = apply(Op(), a0, load(p + i)); \
+            a1 = apply(Op(), a1, load(p + i + w)); \
+            a2 = apply(Op(), a2, load(p + i + 2 * w)); \
+            a3 = apply(Op(), a3, load(p + i + 3 * w)); \
+        } \
+        T lanes[sizeof(vector_type) / sizeof(T)]; \
+        store(lanes, apply(Op(), apply(Op(), a0, a1), apply(Op(), a2, a3))); \
+        result = lanes[0]; \
+        for(std::size_t j = 1; j < w; j++) result = Op::scalar(result, lanes[j]); \
+    } \
+    else result = p[i++]; \
+    for(; i < n; i++) result = Op::scalar(result, p[i]); \
+    return result; \
+}
+
+namespace scalar {
+
+template<class Op, class T>
+T reduce(const T * p, std::size_t n)
+{
+    std::size_t i = 1;
+    T result = p[0];
+    if (n >= 4)
+    {
+        T a0 = p[0], a1 = p[1], a2 = p[2], a3 = p[3];
+        for(i = 4; i + 4 <= n; i += 4)
+        {
+            a0 = Op::scalar(a0, p[i]);
+            a1 = Op::scalar(a1, p[i + 1]);
+            a2 = Op::scalar(a2, p[i + 2]);
+            a3 = Op::scalar(a3, p[i + 3]);
+        }
+        result = Op::scalar(Op::scalar(a0, a1), Op::scalar(a2, a3));
+    }
+    for(; i < n; i++) result = Op::scalar(result, p[i]);
+    return result;
+}
+
+}
+
+#ifdef LINQ_SIMD_X86
+namespace sse2 {
+
+inline __m128i load(const int * p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline __m128 load(const float * p) { return _mm_loadu_ps(p); }
+inline __m128d load(const double * p) { return _mm_loadu_pd(p); }
+
+inline void store(int * p, __m128i x) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x); }
+inline void store(float * p, __m128 x) { _mm_storeu_ps(p, x); }
+inline void store(double * p, __m128d x) { _mm_storeu_pd(p, x); }
+
+inline __m128i apply(sum_op, __m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+inline __m128 apply(sum_op, __m128 x, __m128 y) { return _mm_add_ps(x, y); }
+inline __m128d apply(sum_op, __m128d x, __m128d y) { return _mm_add_pd(x, y); }
+
+// SSE2 doesn't have min and max for 32 bit integers, so they are blended
+// with a comparison mask
+inline __m128i apply(min_op, __m128i x, __m128i y)
+{
+    __m128i mask = _mm_cmpgt_epi32(x, y);
+    return _mm_or_si128(_mm_and_si128(mask, y), _mm_andnot_si128(mask, x));
+}
+inline __m128 apply(min_op, __m128 x, __m128 y) { return _mm_min_ps(x, y); }
+inline __m128d apply(min_op, __m128d x, __m128d y) { return _mm_min_pd(x, y); }
+
+inline __m128i apply(max_op, __m128i x, __m128i y)
+{
+    __m128i mask = _mm_cmpgt_epi32(y, x);
+    return _mm_or_si128(_mm_and_si128(mask, y), _mm_andnot_si128(mask, x));
+}
+inline __m128 apply(max_op, __m128 x, __m128 y) { return _mm_max_ps(x, y); }
+inline __m128d apply(max_op, __m128d x, __m128d y) { return _mm_max_pd(x, y); }
+
+LINQ_SIMD_REDUCE_KERNEL(inline)
+
+}
+
+#define LINQ_SIMD_AVX2 __attribute__((target("avx2")))
+namespace avx2 {
+
+LINQ_SIMD_AVX2 inline __m256i load(const int * p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+LINQ_SIMD_AVX2 inline __m256 load(const float * p) { return _mm256_loadu_ps(p); }
+LINQ_SIMD_AVX2 inline __m256d load(const double * p) { return _mm256_loadu_pd(p); }
+
+LINQ_SIMD_AVX2 inline void store(int * p, __m256i x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+LINQ_SIMD_AVX2 inline void store(float * p, __m256 x) { _mm256_storeu_ps(p, x); }
+LINQ_SIMD_AVX2 inline void store(double * p, __m256d x) { _mm256_storeu_pd(p, x); }
+
+LINQ_SIMD_AVX2 inline __m256i apply(sum_op, __m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+LINQ_SIMD_AVX2 inline __m256 apply(sum_op, __m256 x, __m256 y) { return _mm256_add_ps(x, y); }
+LINQ_SIMD_AVX2 inline __m256d apply(sum_op, __m256d x, __m256d y) { return _mm256_add_pd(x, y); }
+
+LINQ_SIMD_AVX2 inline __m256i apply(min_op, __m256i x, __m256i y) { return _mm256_min_epi32(x, y); }
+LINQ_SIMD_AVX2 inline __m256 apply(min_op, __m256 x, __m256 y) { return _mm256_min_ps(x, y); }
+LINQ_SIMD_AVX2 inline __m256d apply(min_op, __m256d x, __m256d y) { return _mm256_min_pd(x, y); }
+
+LINQ_SIMD_AVX2 inline __m256i apply(max_op, __m256i x, __m256i y) { return _mm256_max_epi32(x, y); }
+LINQ_SIMD_AVX2 inline __m256 apply(max_op, __m256 x, __m256 y) { return _mm256_max_ps(x, y); }
+LINQ_SIMD_AVX2 inline __m256d apply(max_op, __m256d x, __m256d y) { return _mm256_max_pd(x, y); }
+
+LINQ_SIMD_REDUCE_KERNEL(LINQ_SIMD_AVX2)
+
+inline bool supported()
+{
+    static const bool result = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return result;
+}
+
+}
+#endif
+
+#ifdef LINQ_SIMD_NEON
+namespace neon {
+
+inline int32x4_t load(const int * p) { return vld1q_s32(p); }
+inline float32x4_t load(const float * p) { return vld1q_f32(p); }
+inline float64x2_t load(const double * p) { return vld1q_f64(p); }
+
+inline void store(int * p, int32x4_t x) { vst1q_s32(p, x); }
+inline void store(float * p, float32x4_t x) { vst1q_f32(p, x); }
+inline void store(double * p, float64x2_t x) { vst1q_f64(p, x); }
+
+inline int32x4_t apply(sum_op, int32x4_t x, int32x4_t y) { return vaddq_s32(x, y); }
+inline float32x4_t apply(sum_op, float32x4_t x, float32x4_t y) { return vaddq_f32(x, y); }
+inline float64x2_t apply(sum_op, float64x2_t x, float64x2_t y) { return vaddq_f64(x, y); }
+
+inline int32x4_t apply(min_op, int32x4_t x, int32x4_t y) { return vminq_s32(x, y); }
+inline float32x4_t apply(min_op, float32x4_t x, float32x4_t y) { return vminq_f32(x, y); }
+inline float64x2_t apply(min_op, float64x2_t x, float64x2_t y) { return vminq_f64(x, y); }
+
+inline int32x4_t apply(max_op, int32x4_t x, int32x4_t y) { return vmaxq_s32(x, y); }
+inline float32x4_t apply(max_op, float32x4_t x, float32x4_t y) { return vmaxq_f32(x, y); }
+inline float64x2_t apply(max_op, float64x2_t x, float64x2_t y) { return vmaxq_f64(x, y); }
+
+LINQ_SIMD_REDUCE_KERNEL(inline)
+
+}
+#endif
+
+template<class Op, class T>
+T reduce(const T * p, std::size_t n)
+{
+#if defined(LINQ_SIMD_X86)
+    if (avx2::supported()) return avx2::reduce<Op>(p, n);
+    return sse2::reduce<Op>(p, n);
+#elif defined(LINQ_SIMD_NEON)
+    return neon::reduce<Op>(p, n);
+#else
+    return scalar::reduce<Op>(p, n);
+#endif
+}
+
+}
+
+// Reduces a range for which is_simd_range is true. The sum of an empty range
+// is zero, but there is no min or max of an empty range.
+template<class Op, class Range>
+typename boost::range_value<typename std::remove_reference<Range>::type>::type
+simd_reduce(Range && r, const char * name)
+{
+    typedef typename boost::range_value<typename std::remove_reference<Range>::type>::type value_type;
+    if (boost::empty(r))
+    {
+        if (std::is_same<Op, simd::sum_op>::value) return value_type();
+        throw std::out_of_range(name);
+    }
+    return simd::reduce<Op>(std::addressof(*boost::begin(r)), boost::end(r) - boost::begin(r));
+}
+
+}
+
+}
+
+#endif
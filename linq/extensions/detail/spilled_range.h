@@ -0,0 +1,255 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    spilled_range.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_DETAIL_SPILLED_RANGE_H
+#define LINQ_GUARD_DETAIL_SPILLED_RANGE_H
+
+#include <linq/extensions/detail/ordered_range.h>
+#include <linq/serializer.h>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/range.hpp>
+#include <linq/traits.h>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace linq {
+
+//
+// spilled_range
+//
+// An ordered range that uses at most about `budget` bytes for the elements it
+// sorts. The source is read once, and the elements are copied into a buffer
+// until it is full. Then the buffer is sorted and written to a temporary file
+// as a sorted run. Iterating the range merges the runs back with a k-way
+// merge, so the sorted elements are read from the files one at a time. The
+// runs are in the order of the source and the earlier runs win ties, so the
+// sort is stable. The keys are computed again when the elements are read
+// back, instead of being written to the files. After take, the merge stops
+// once it has read the first elements.
+//
+// The elements are written with linq::serializer, which has to be
+// specialized for types that aren't trivially copyable, and they have to be
+// default constructible.
+//
+namespace detail {
+
+struct file_closer
+{
+    void operator()(std::FILE * f) const
+    {
+        std::fclose(f);
+    }
+};
+
+template<class T, class Key, class KeyType>
+struct spill_merger
+{
+    typedef std::pair<KeyType, T> record;
+    // The run of each head, with the run in memory last
+    typedef std::pair<record, std::size_t> head;
+
+    Key key;
+    std::vector<std::unique_ptr<std::FILE, file_closer> > files;
+    // The number of elements of each run that haven't been read yet
+    std::vector<std::size_t> unread;
+    std::vector<record> memory;
+    std::size_t memory_position;
+    std::vector<head> heads;
+    T current;
+    bool done;
+    // The number of elements that are left to read, from take
+    std::size_t remaining;
+
+    struct head_compare
+    {
+        Key key;
+
+        head_compare(Key key) : key(key)
+        {}
+
+        // The heap keeps the greatest element first, so this is reversed
+        bool operator()(const head& x, const head& y) const
+        {
+            if (key.less(y.first.first, x.first.first)) return true;
+            if (key.less(x.first.first, y.first.first)) return false;
+            return y.second < x.second;
+        }
+    };
+
+    spill_merger(Key key) : key(key), memory_position(0), done(false), remaining(0)
+    {}
+
+    template<class Policy>
+    void spill(const Policy& policy, std::vector<record>& buffer)
+    {
+        sort_records(policy, buffer, key);
+        std::unique_ptr<std::FILE, file_closer> f(std::tmpfile());
+        if (!f) throw std::runtime_error("linq::spill failed to create a temporary file");
+        for(std::size_t i = 0; i < buffer.size(); i++) serializer<T>::write(f.get(), buffer[i].second);
+        if (std::fflush(f.get()) != 0) throw std::runtime_error("linq::spill failed to write");
+        std::rewind(f.get());
+        files.push_back(std::move(f));
+        unread.push_back(buffer.size());
+        buffer.clear();
+    }
+
+    bool read(std::size_t run, head& h)
+    {
+        if (run < files.size())
+        {
+            if (unread[run] == 0) return false;
+            T x;
+            if (!serializer<T>::read(files[run].get(), x)) throw std::runtime_error("linq::spill failed to read a run");
+            unread[run]--;
+            KeyType k = key(x);
+            h = head(record(std::move(k), std::move(x)), run);
+            return true;
+        }
+        if (memory_position == memory.size()) return false;
+        h = head(std::move(memory[memory_position++]), run);
+        return true;
+    }
+
+    template<class Iterator, class Policy>
+    void start(Iterator first, Iterator last, const Policy& policy, std::size_t budget, std::size_t limit)
+    {
+        remaining = limit;
+        std::size_t used = 0;
+        for(Iterator it = first; it != last; ++it)
+        {
+            T x = *it;
+            KeyType k = key(x);
+            used += sizeof(record) + serializer<T>::size(x);
+            memory.push_back(record(std::move(k), std::move(x)));
+            if (used >= budget)
+            {
+                this->spill(policy, memory);
+                used = 0;
+            }
+        }
+        sort_records(policy, memory, key);
+        for(std::size_t run = 0; run <= files.size(); run++)
+        {
+            head h;
+            if (this->read(run, h)) heads.push_back(std::move(h));
+        }
+        std::make_heap(heads.begin(), heads.end(), head_compare(key));
+        this->next();
+    }
+
+    void next()
+    {
+        if (heads.empty() or remaining == 0)
+        {
+            done = true;
+            return;
+        }
+        remaining--;
+        head_compare c(key);
+        std::pop_heap(heads.begin(), heads.end(), c);
+        current = std::move(heads.back().first.second);
+        if (this->read(heads.back().second, heads.back())) std::push_heap(heads.begin(), heads.end(), c);
+        else heads.pop_back();
+    }
+};
+
+template<class T, class Key, class KeyType>
+struct spill_iterator
+: boost::iterator_facade
+<
+    spill_iterator<T, Key, KeyType>,
+    T,
+    boost::single_pass_traversal_tag,
+    const T&
+>
+{
+    std::shared_ptr<spill_merger<T, Key, KeyType> > merger;
+
+    spill_iterator()
+    {}
+
+    spill_iterator(std::shared_ptr<spill_merger<T, Key, KeyType> > merger) : merger(merger)
+    {}
+
+    bool at_end() const
+    {
+        return !merger or merger->done;
+    }
+
+    bool equal(const spill_iterator& other) const
+    {
+        return this->at_end() == other.at_end() and (this->at_end() or merger == other.merger);
+    }
+
+    void increment()
+    {
+        merger->next();
+    }
+
+    const T& dereference() const
+    {
+        return merger->current;
+    }
+};
+
+}
+
+template<class Iterator, class Key, class Policy>
+struct spilled_range
+{
+    typedef typename boost::iterator_value<Iterator>::type value_type;
+    typedef typename ordered_range<Iterator, Key, Policy>::key_type key_type;
+    typedef detail::spill_merger<value_type, Key, key_type> merger_type;
+    typedef detail::spill_iterator<value_type, Key, key_type> iterator;
+    typedef iterator const_iterator;
+
+    Iterator first, last;
+    Key key;
+    Policy policy;
+    std::size_t budget;
+    std::size_t limit;
+    mutable std::shared_ptr<merger_type> merger;
+
+    spilled_range(Iterator first, Iterator last, Key key, Policy policy, std::size_t budget, std::size_t limit)
+    : first(first), last(last), key(key), policy(policy), budget(budget), limit(limit)
+    {}
+
+    // The range can only be iterated once
+    iterator begin() const
+    {
+        if (!merger)
+        {
+            merger = std::make_shared<merger_type>(key);
+            merger->start(first, last, policy, budget, limit);
+        }
+        return iterator(merger);
+    }
+
+    iterator end() const
+    {
+        return iterator();
+    }
+};
+
+template<class Iterator, class Key, class Policy>
+struct is_bindable_range<spilled_range<Iterator, Key, Policy> >
+: boost::mpl::bool_<true>
+{};
+
+template<class Iterator, class Key, class Policy>
+spilled_range<Iterator, Key, Policy> make_spilled_range(const ordered_range<Iterator, Key, Policy>& r, std::size_t budget)
+{
+    return spilled_range<Iterator, Key, Policy>(r.first, r.last, r.key, r.policy, budget, r.limit);
+}
+
+}
+
+#endif
@@ -24,15 +24,7 @@ struct distinct_t
         template<class T, class Set>
         bool operator()(const T& x, Set& s) const
         {
-            if (s.find(x) == s.end())
-            {
-                s.insert(x);
-                return true;
-            }
-            else
-            {
-                return false;
-            }
+            return s.insert(x);
         }
     };
     // TODO: Add support for an equality selector
@@ -9,7 +9,10 @@
 #define LINQ_GUARD_EXTENSIONS_ELEMENT_AT_H
 
 #include <linq/extensions/extension.h>
+#include <linq/extensions/detail/ordered_range.h>
 #include <boost/range.hpp>
+#include <boost/mpl/not.hpp>
+#include <stdexcept>
 
 
 namespace linq { 
@@ -23,7 +26,20 @@ struct element_at_t
     // TODO: Throw when its out of range
     // TODO: Add overload to provide a fallback value when its out of range
     template<class Range>
-    auto operator()(Range && r, std::size_t n) const LINQ_RETURNS(*(boost::next(boost::begin(r), n)));
+    auto operator()(Range && r, std::size_t n) const LINQ_RETURN_REQUIRES(boost::mpl::not_<is_ordered_range<Range> >)
+    (*(boost::next(boost::begin(r), n)));
+
+    template<class Range>
+    static typename boost::range_reference<Range>::type ordered_element_at(const Range& r, std::size_t n)
+    {
+        auto top = r.take(n + 1);
+        if (boost::size(top) <= n) throw std::out_of_range("linq::element_at failed");
+        return *(boost::prior(boost::end(top)));
+    }
+
+    template<class Range>
+    auto operator()(Range && r, std::size_t n) const LINQ_RETURN_REQUIRES(is_ordered_range<Range>)
+    (ordered_element_at(r, n));
 };
 }
 namespace {
@@ -9,7 +9,9 @@
 #define LINQ_GUARD_EXTENSIONS_FIRST_H
 
 #include <linq/extensions/extension.h>
+#include <linq/extensions/detail/ordered_range.h>
 #include <boost/range.hpp>
+#include <boost/mpl/bool.hpp>
 
 namespace linq { 
 
@@ -41,10 +43,22 @@ struct first_t
     };
 
     template<class Range>
-    typename result<first_t(Range&&)>::type operator()(Range && r) const 
+    static typename result<first_t(Range&&)>::type first(Range && r, boost::mpl::bool_<false>)
     {
         if (boost::empty(r)) throw std::out_of_range("linq::first failed");
         return *(boost::begin(r));
+    }
+
+    template<class Range>
+    static typename result<first_t(Range&&)>::type first(Range && r, boost::mpl::bool_<true>)
+    {
+        return first_t::first(r.take(1), boost::mpl::bool_<false>());
+    }
+
+    template<class Range>
+    typename result<first_t(Range&&)>::type operator()(Range && r) const 
+    {
+        return first_t::first(r, is_ordered_range<Range>());
     };
 
 };
@@ -0,0 +1,40 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    fused.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_EXTENSIONS_FUSED_H
+#define LINQ_GUARD_EXTENSIONS_FUSED_H
+
+#include <linq/extensions/extension.h>
+#include <linq/extensions/detail/fused_range.h>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+
+namespace linq { 
+
+//
+// fused
+//
+// Starts a pipeline that is run by the terminal extension in a single loop.
+// The where, select and select_many extensions add a stage to the pipeline,
+// and the aggregate, sum, min, max, count, any, all and to_container
+// extensions drive it. Every other extension just iterates over the range.
+//
+namespace detail {
+struct fused_t
+{
+    template<class Range>
+    auto operator()(Range && r) const LINQ_RETURNS
+    (make_fused_range(boost::begin(r), boost::end(r), identity_stage(), boost::make_iterator_range(boost::begin(r), boost::end(r))));
+};
+}
+namespace {
+range_extension<detail::fused_t, true> fused = {};
+}
+
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    group_aggregate.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_EXTENSIONS_GROUP_AGGREGATE_H
+#define LINQ_GUARD_EXTENSIONS_GROUP_AGGREGATE_H
+
+#include <linq/extensions/extension.h>
+#include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
+#include <linq/extensions/detail/flat_map.h>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+#include <type_traits>
+#include <utility>
+
+namespace linq {
+
+//
+// group_aggregate
+//
+// Groups the range by the key selector and aggregates each group, without
+// keeping the elements. There is one accumulator for each key, which starts
+// from the seed, and each element is reduced into the accumulator of its
+// key. It returns a flat_map from each key to its accumulator:
+//
+//     auto totals = orders | linq::group_aggregate(customer, 0.0, [](double sum, const order& o) { return sum + o.total; });
+//
+// After par, each thread aggregates its chunks into its own map, starting
+// each key from a copy of the seed, and the accumulators of the same key are
+// combined with the combiner. So par needs a combiner, such as std::plus for
+// a count or a sum from 0:
+//
+//     auto counts = orders | linq::par | linq::group_aggregate(customer, 0, [](int n, const order&) { return n + 1; }, std::plus<int>());
+//
+namespace detail {
+
+template<class Key, class Seed, class KeySelector, class Reducer, class Combiner>
+struct group_aggregate_sink
+{
+    KeySelector ks;
+    Seed seed;
+    Reducer reducer;
+    Combiner combiner;
+    flat_map<Key, Seed> map;
+
+    group_aggregate_sink(KeySelector ks, Seed seed, Reducer reducer, Combiner combiner)
+    : ks(ks), seed(seed), reducer(reducer), combiner(combiner)
+    {}
+
+    template<class T>
+    bool operator()(T && x)
+    {
+        Seed& acc = map.get(ks(x), seed);
+        acc = reducer(std::move(acc), std::forward<T>(x));
+        return true;
+    }
+
+    group_aggregate_sink split() const
+    {
+        return group_aggregate_sink(ks, seed, reducer, combiner);
+    }
+
+    void join(group_aggregate_sink& other)
+    {
+        for(std::size_t i = 0; i < other.map.size(); i++)
+        {
+            std::pair<std::size_t, bool> r = map.table.insert(std::move(other.map.table.keys[i]));
+            if (r.second) map.values.push_back(std::move(other.map.values[i]));
+            else map.values[r.first] = combiner(std::move(map.values[r.first]), std::move(other.map.values[i]));
+        }
+    }
+};
+
+template<class Range, class Seed, class KeySelector, class Reducer, class Combiner>
+struct as_group_aggregate_sink
+{
+    typedef typename boost::range_reference<typename std::remove_reference<Range>::type>::type reference;
+    typedef group_aggregate_sink
+    <
+        typename std::decay<decltype(std::declval<KeySelector>()(std::declval<reference>()))>::type,
+        typename std::decay<Seed>::type,
+        KeySelector,
+        Reducer,
+        Combiner
+    > type;
+};
+
+template<class Range, class Seed, class KeySelector, class Reducer, class Combiner>
+typename as_group_aggregate_sink<Range, Seed, KeySelector, Reducer, Combiner>::type
+make_group_aggregate_sink(KeySelector ks, Seed && s, Reducer reducer, Combiner combiner)
+{
+    return typename as_group_aggregate_sink<Range, Seed, KeySelector, Reducer, Combiner>::type(ks, s, reducer, combiner);
+}
+
+// Only sequential pipelines can leave out the combiner, since they never
+// split the sink
+template<class Range, class Reducer>
+Reducer group_aggregate_default_combiner(Reducer reducer)
+{
+    static_assert(!is_parallel_range<Range>::value,
+        "par | group_aggregate needs a combiner for the accumulators of each thread: group_aggregate(key_selector, seed, reducer, combiner)");
+    return reducer;
+}
+
+struct group_aggregate_t
+{
+    template<class Range, class Sink>
+    static decltype(std::declval<Sink>().map) run(Range && r, Sink sink, boost::mpl::bool_<false>)
+    {
+        for(auto it = boost::begin(r); it != boost::end(r); ++it) sink(*it);
+        return std::move(sink.map);
+    }
+
+    template<class Range, class Sink>
+    static decltype(std::declval<Sink>().map) run(Range && r, Sink sink, boost::mpl::bool_<true>)
+    {
+        r.push(sink);
+        return std::move(sink.map);
+    }
+
+    template<class Range, class Seed, class KeySelector, class Reducer>
+    auto operator()(Range && r, KeySelector ks, Seed && s, Reducer reducer) const LINQ_RETURNS
+    (
+        run(r, make_group_aggregate_sink<Range>(make_function_object(ks), s, make_function_object(reducer), group_aggregate_default_combiner<Range>(make_function_object(reducer))),
+            is_fused_range<Range>())
+    );
+
+    template<class Range, class Seed, class KeySelector, class Reducer, class Combiner>
+    auto operator()(Range && r, KeySelector ks, Seed && s, Reducer reducer, Combiner combiner) const LINQ_RETURNS
+    (
+        run(r, make_group_aggregate_sink<Range>(make_function_object(ks), s, make_function_object(reducer), make_function_object(combiner)),
+            is_fused_range<Range>())
+    );
+};
+}
+namespace {
+range_extension<detail::group_aggregate_t> group_aggregate = {};
+}
+
+}
+
+#endif
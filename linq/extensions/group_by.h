@@ -11,6 +11,7 @@
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/identity.h>
 #include <linq/extensions/detail/make_map.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <linq/extensions/detail/placeholders.h>
 #include <linq/extensions/detail/defer.h>
 #include <linq/extensions/select.h>
@@ -18,12 +19,19 @@
 #include <boost/range.hpp>
 #include <functional>
 #include <map>
+#include <vector>
 
 namespace linq { 
 
 //
 // group_by
 //
+// After fused or par, the elements are pushed into the groups. After par,
+// each thread groups its chunks into its own table, and then the tables are
+// joined in order, by finding the keys of each table in the first one and
+// appending its elements, so the groups and their elements stay in the
+// order of the source.
+//
 namespace detail {
 
 template<class KeySelector, class ElementSelector>
@@ -65,6 +73,47 @@ make_group_by_map_selector (KeySelector && key_selector, ElementSelector && elem
     (std::forward<KeySelector>(key_selector), std::forward<ElementSelector>(element_selector));
 }
 
+template<class Map, class Selector>
+struct group_by_sink
+{
+    Selector selector;
+    Map map;
+    // The id of the group of each element, before the groups are contiguous
+    std::vector<std::size_t> ids;
+
+    group_by_sink(Selector selector)
+    : selector(selector)
+    {}
+
+    template<class T>
+    bool operator()(T && x)
+    {
+        typename Map::value_type p = selector(std::forward<T>(x));
+        ids.push_back(map.table.insert(p.first).first);
+        map.elements.push_back(std::move(p));
+        return true;
+    }
+
+    group_by_sink split() const
+    {
+        return group_by_sink(selector);
+    }
+
+    void join(group_by_sink& other)
+    {
+        std::vector<std::size_t> ids_of_other(other.map.table.size());
+        for(std::size_t i = 0; i < ids_of_other.size(); i++) ids_of_other[i] = map.table.insert(std::move(other.map.table.keys[i])).first;
+        for(std::size_t i = 0; i < other.ids.size(); i++) ids.push_back(ids_of_other[other.ids[i]]);
+        map.elements.insert(map.elements.end(), std::make_move_iterator(other.map.elements.begin()), std::make_move_iterator(other.map.elements.end()));
+    }
+
+    Map finish()
+    {
+        map.group(ids);
+        return std::move(map);
+    }
+};
+
 struct group_by_t
 {
     template<class>
@@ -73,7 +122,7 @@ struct group_by_t
     template<class F, class Range, class KeySelector, class ElementSelector>
     struct result<F(Range, KeySelector, ElementSelector)>
     {
-        typedef typename as_unordered_map<typename result_of<detail::select_t(Range, group_by_map_selector<KeySelector, ElementSelector>)>::type >::type type;
+        typedef typename as_flat_multimap<typename result_of<detail::select_t(Range, group_by_map_selector<KeySelector, ElementSelector>)>::type >::type type;
     };
 
     template<class F, class Range, class KeySelector, class ElementSelector>
@@ -86,10 +135,25 @@ struct group_by_t
     : result<F(Range, KeySelector, identity_selector)>
     {};
 
+    template<class Map, class Range, class Selector>
+    static Map group(Range && r, Selector selector, boost::mpl::bool_<false>)
+    {
+        return make_map( r | linq::select(selector) );
+    }
+
+    template<class Map, class Range, class Selector>
+    static Map group(Range && r, Selector selector, boost::mpl::bool_<true>)
+    {
+        group_by_sink<Map, Selector> sink(selector);
+        r.push(sink);
+        return sink.finish();
+    }
+
     template<class Range, class KeySelector>
     typename result<group_by_t(Range&&, KeySelector)>::type operator()(Range && r, KeySelector ks) const
     {
-        return make_map( r | linq::select(make_group_by_map_selector(ks, identity_selector())) );
+        typedef typename result<group_by_t(Range&&, KeySelector)>::type map;
+        return group<map>(r, make_group_by_map_selector(ks, identity_selector()), is_fused_range<Range>());
     };
 
     // TODO: Custom comparer overloads can't be supported right now, 
@@ -99,7 +163,8 @@ struct group_by_t
     template<class Range, class KeySelector, class ElementSelector>
     typename result<group_by_t(Range&&, KeySelector, ElementSelector)>::type operator()(Range && r, KeySelector ks, ElementSelector es) const
     {
-        return make_map( r | linq::select(make_group_by_map_selector(ks, es)) );
+        typedef typename result<group_by_t(Range&&, KeySelector, ElementSelector)>::type map;
+        return group<map>(r, make_group_by_map_selector(ks, es), is_fused_range<Range>());
     };
 
 };
@@ -0,0 +1,43 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    group_by_ref.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_EXTENSIONS_GROUP_BY_REF_H
+#define LINQ_GUARD_EXTENSIONS_GROUP_BY_REF_H
+
+#include <linq/extensions/extension.h>
+#include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/lookup.h>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+
+namespace linq {
+
+//
+// group_by_ref
+//
+// Groups the range like group_by, without copying the elements. It returns
+// a ref_lookup, which keeps an iterator to each element, so the groups are
+// ranges of references into the source, and the source has to outlive them:
+//
+//     auto by_customer = orders | linq::group_by_ref([](const order& o) { return o.customer; });
+//     for(auto&& g : by_customer) for(const order& o : g) ...
+//
+namespace detail {
+struct group_by_ref_t
+{
+    template<class Range, class KeySelector>
+    auto operator()(Range && r, KeySelector ks) const LINQ_RETURNS
+    (make_ref_lookup(r, make_function_object(ks)));
+};
+}
+namespace {
+range_extension<detail::group_by_ref_t> group_by_ref = {};
+}
+
+}
+
+#endif
@@ -24,13 +24,7 @@ struct intersect_t
         template<class T, class Set>
         bool operator()(const T& x, Set & s) const
         {
-            auto it = s.find(x);
-            if (it != s.end())
-            {
-                s.erase(it);
-                return true;
-            }
-            else return false;
+            return s.erase(x);
         }
     };
     // TODO: Add support for an equality selector
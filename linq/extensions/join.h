@@ -9,105 +9,72 @@
 #define LINQ_GUARD_EXTENSIONS_JOIN_H
 
 #include <linq/extensions/extension.h>
-#include <linq/extensions/group_join.h>
-#include <linq/extensions/select_many.h>
-#include <linq/extensions/select.h>
-
-
+#include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/join.h>
+#include <linq/extensions/detail/partitioned_join.h>
 #include <linq/utility.h>
 
 namespace linq { 
-namespace detail {
-
 
+//
+// join
+//
+// The inner range is grouped into a join table, and the outer range is
+// probed in batches, so the results come out of one flat iterator, in the
+// order of the outer range, and for each outer element in the order of the
+// inner range. The smaller range is hashed, when the sizes of both are
+// known, unless linq::build_inner or linq::build_outer is given. With
+// linq::build_partitioned, both ranges are split into partitions that fit in
+// the cache, which are joined in parallel. With linq::probe_inner, the outer
+// range is hashed and the inner range is streamed, so the results are in the
+// order of the inner range.
+//
+namespace detail {
 struct join_t
 {
-    template<class ResultSelector, class Key>
-    struct apply_result_selector
-    {
-        ResultSelector rs;
-        Key k;
-
-        apply_result_selector(ResultSelector rs, Key k)
-        : rs(rs), k(k)
-        {}
-
-        template<class T>
-        auto operator()(T && x) const -> decltype(declval<const ResultSelector>()(declval<const Key>(), std::forward<T>(x)))
-        {
-            return rs(k, std::forward<T>(x));
-        }
-    };
-
-    template<class ResultSelector, class Key>
-    static apply_result_selector < ResultSelector, Key >
-    make_apply_result_selector (ResultSelector rs, Key k)
-    {
-        return apply_result_selector < ResultSelector, Key >
-        (rs, k);
-    }
-
-
-    template<class ResultSelector>
-    struct result_selector
-    {
-        ResultSelector rs;
-
-        result_selector(ResultSelector rs)
-        : rs(rs)
-        {}
-
-        template<class>
-        struct result;
-
-        template<class X, class Key, class Value>
-        struct result<X(Key, Value)>
-        {
-            typedef decltype(declval<Value>() | linq::select(make_apply_result_selector(declval<const ResultSelector>(), declval<Key>()))) type;
-        };
-
-        template<class Key, class Value>
-        typename result<result_selector(Key&&, Value&&)>::type
-        operator()(Key && k, Value && v) const // -> decltype(v | linq::select(make_apply_result_selector(declval<const ResultSelector>(), k)))
-        {
-            return v | linq::select(make_apply_result_selector(rs, k));
-        };
-    };
-
-    template<class ResultSelector>
-    static result_selector< function_object<ResultSelector> >
-    make_result_selector (ResultSelector rs)
-    {
-        return result_selector < function_object<ResultSelector> >
-        (make_function_object(rs));
-    }
-
-    template<class>
-    struct result;
+    template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector, int Side>
+    auto operator()(Outer && outer, Inner && inner, OuterKeySelector outer_key_selector, InnerKeySelector inner_key_selector, ResultSelector rs, join_build_side<Side> side) const LINQ_RETURNS
+    (
+        make_join_range
+        (
+            outer,
+            make_join_table(std::forward<Inner>(inner), make_function_object(inner_key_selector), outer, make_function_object(outer_key_selector), side),
+            make_function_object(outer_key_selector),
+            make_function_object(rs)
+        )
+    );
 
-    template<class X, class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
-    struct result<X(Outer, Inner, OuterKeySelector, InnerKeySelector, ResultSelector)>
-    {
-        static Outer && outer;
-        static Inner && inner;
-        static OuterKeySelector&& outer_key_selector;
-        static InnerKeySelector&& inner_key_selector;
-        static ResultSelector&& rs;
+    template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+    auto operator()(Outer && outer, Inner && inner, OuterKeySelector outer_key_selector, InnerKeySelector inner_key_selector, ResultSelector rs, join_build_partitioned) const LINQ_RETURNS
+    (
+        make_partitioned_join_range
+        (
+            outer,
+            std::forward<Inner>(inner),
+            make_function_object(outer_key_selector),
+            make_function_object(inner_key_selector),
+            make_function_object(rs)
+        )
+    );
 
-        typedef decltype
+    template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+    auto operator()(Outer && outer, Inner && inner, OuterKeySelector outer_key_selector, InnerKeySelector inner_key_selector, ResultSelector rs, join_probe_inner) const LINQ_RETURNS
+    (
+        make_probe_inner_join_range
         (
-            outer | linq::group_join(std::forward<Inner>(inner), outer_key_selector, inner_key_selector, make_result_selector(rs))
-            | linq::select_many(linq::detail::identity_selector())
-        ) type;
-    };
-    
+            outer,
+            std::forward<Inner>(inner),
+            make_function_object(outer_key_selector),
+            make_function_object(inner_key_selector),
+            make_function_object(rs)
+        )
+    );
+
     template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
-    typename result<join_t(Outer&&, Inner&&, OuterKeySelector, InnerKeySelector, ResultSelector)>::type
-    operator()(Outer && outer, Inner && inner, OuterKeySelector outer_key_selector, InnerKeySelector inner_key_selector, ResultSelector rs) const
-    {
-        return outer | linq::group_join(std::forward<Inner>(inner), outer_key_selector, inner_key_selector, make_result_selector(rs))
-        | linq::select_many(linq::detail::identity_selector());
-    }
+    auto operator()(Outer && outer, Inner && inner, OuterKeySelector outer_key_selector, InnerKeySelector inner_key_selector, ResultSelector rs) const LINQ_RETURNS
+    (
+        (*this)(outer, std::forward<Inner>(inner), outer_key_selector, inner_key_selector, rs, join_build_auto())
+    );
 };
 }
 namespace {
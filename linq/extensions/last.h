@@ -11,7 +11,9 @@
 #include <linq/extensions/extension.h>
 #include <linq/extensions/first.h>
 #include <linq/extensions/reverse.h>
+#include <linq/extensions/detail/ordered_range.h>
 #include <boost/range.hpp>
+#include <boost/mpl/bool.hpp>
 
 namespace linq { 
 namespace detail {
@@ -37,10 +39,25 @@ struct last_t
     };
 
     template<class Range>
-    typename result<last_t(Range&&)>::type operator()(Range && r) const
+    static typename result<last_t(Range&&)>::type last(Range && r, boost::mpl::bool_<false>)
     {
         if (boost::empty(r)) throw std::out_of_range("linq::last failed");
     	return *(--boost::end(r));
+    }
+
+    // The last element of an ordered range is found without sorting
+    template<class Range>
+    static typename result<last_t(Range&&)>::type last(Range && r, boost::mpl::bool_<true>)
+    {
+        auto it = r.last_element();
+        if (it == r.last) throw std::out_of_range("linq::last failed");
+        return *it;
+    }
+
+    template<class Range>
+    typename result<last_t(Range&&)>::type operator()(Range && r) const
+    {
+        return last_t::last(r, is_ordered_range<Range>());
     };
 };
 }
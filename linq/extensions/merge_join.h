@@ -0,0 +1,169 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    merge_join.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_EXTENSIONS_MERGE_JOIN_H
+#define LINQ_GUARD_EXTENSIONS_MERGE_JOIN_H
+
+#include <linq/extensions/extension.h>
+#include <linq/extensions/detail/function_object.h>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+#include <type_traits>
+#include <utility>
+
+namespace linq {
+
+//
+// merge_join
+//
+// Joins two ranges that are already sorted by their keys, in ascending
+// order, like join but without a hash table. Both ranges are read once, side
+// by side. The inner range only goes back to the start of the run of rows
+// with the same key, when the next outer element has the same key again, so
+// nothing is stored besides the iterators:
+//
+//     auto q = logs | linq::merge_join(events, log_time, event_time, [](const log& l, const event& e) { ... });
+//
+// The results are in the same order as join, which is the order of the outer
+// range, and for each outer element the order of the inner range. When
+// either range isn't sorted, some of the results are missing.
+//
+namespace detail {
+
+template<class OuterIterator, class InnerIterator, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+struct merge_join_iterator_types
+{
+    typedef decltype(std::declval<const ResultSelector&>()
+    (
+        std::declval<typename boost::iterator_reference<OuterIterator>::type>(),
+        std::declval<typename boost::iterator_reference<InnerIterator>::type>()
+    )) reference;
+    typedef typename std::decay<reference>::type value_type;
+};
+
+template<class OuterIterator, class InnerIterator, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+struct merge_join_iterator
+: boost::iterator_facade
+<
+    merge_join_iterator<OuterIterator, InnerIterator, OuterKeySelector, InnerKeySelector, ResultSelector>,
+    typename merge_join_iterator_types<OuterIterator, InnerIterator, OuterKeySelector, InnerKeySelector, ResultSelector>::value_type,
+    boost::forward_traversal_tag,
+    typename merge_join_iterator_types<OuterIterator, InnerIterator, OuterKeySelector, InnerKeySelector, ResultSelector>::reference
+>
+{
+    typedef typename merge_join_iterator_types<OuterIterator, InnerIterator, OuterKeySelector, InnerKeySelector, ResultSelector>::reference reference;
+
+    OuterKeySelector os;
+    InnerKeySelector is;
+    ResultSelector rs;
+    OuterIterator outer, outer_last;
+    // The run of inner rows with the same key, and the row of the run that
+    // is paired with the current outer element
+    InnerIterator run_first, run_last, inner_last, row;
+
+    merge_join_iterator()
+    {}
+
+    merge_join_iterator(OuterKeySelector os, InnerKeySelector is, ResultSelector rs, OuterIterator outer, OuterIterator outer_last, InnerIterator inner, InnerIterator inner_last)
+    : os(os), is(is), rs(rs), outer(outer), outer_last(outer_last), run_first(inner), run_last(inner), inner_last(inner_last), row(inner)
+    {
+        this->find_match();
+    }
+
+    // Moves to the next outer element, starting at outer, that has a run of
+    // inner rows with the same key
+    void find_match()
+    {
+        for(; outer != outer_last; ++outer)
+        {
+            auto&& k = os(*outer);
+            if (run_first == run_last or is(*run_first) < k)
+            {
+                run_first = run_last;
+                while (run_first != inner_last and is(*run_first) < k) ++run_first;
+                run_last = run_first;
+                while (run_last != inner_last and !(k < is(*run_last))) ++run_last;
+            }
+            if (run_first != run_last and !(k < is(*run_first)))
+            {
+                row = run_first;
+                return;
+            }
+        }
+    }
+
+    reference dereference() const
+    {
+        return rs(*outer, *row);
+    }
+
+    void increment()
+    {
+        if (++row != run_last) return;
+        ++outer;
+        this->find_match();
+    }
+
+    bool equal(const merge_join_iterator& other) const
+    {
+        if (outer == outer_last or other.outer == other.outer_last) return outer == other.outer;
+        return outer == other.outer and row == other.row;
+    }
+};
+
+template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+struct merge_join_range_types
+{
+    typedef merge_join_iterator
+    <
+        typename boost::range_iterator<typename std::remove_reference<Outer>::type>::type,
+        typename boost::range_iterator<typename std::remove_reference<Inner>::type>::type,
+        OuterKeySelector,
+        InnerKeySelector,
+        ResultSelector
+    > iterator;
+    typedef boost::iterator_range<iterator> type;
+};
+
+template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+typename merge_join_range_types<Outer, Inner, OuterKeySelector, InnerKeySelector, ResultSelector>::type
+make_merge_join_range(Outer && outer, Inner && inner, OuterKeySelector os, InnerKeySelector is, ResultSelector rs)
+{
+    static_assert(std::is_lvalue_reference<Inner>::value or !std::is_reference<typename boost::range_reference<typename std::remove_reference<Inner>::type>::type>::value,
+        "merge_join reads the inner range while it is iterated, so it can't be a temporary container");
+    typedef typename merge_join_range_types<Outer, Inner, OuterKeySelector, InnerKeySelector, ResultSelector>::iterator iterator;
+    return boost::make_iterator_range
+    (
+        iterator(os, is, rs, boost::begin(outer), boost::end(outer), boost::begin(inner), boost::end(inner)),
+        iterator(os, is, rs, boost::end(outer), boost::end(outer), boost::end(inner), boost::end(inner))
+    );
+}
+
+struct merge_join_t
+{
+    template<class Outer, class Inner, class OuterKeySelector, class InnerKeySelector, class ResultSelector>
+    auto operator()(Outer && outer, Inner && inner, OuterKeySelector outer_key_selector, InnerKeySelector inner_key_selector, ResultSelector rs) const LINQ_RETURNS
+    (
+        make_merge_join_range
+        (
+            outer,
+            std::forward<Inner>(inner),
+            make_function_object(outer_key_selector),
+            make_function_object(inner_key_selector),
+            make_function_object(rs)
+        )
+    );
+};
+}
+namespace {
+range_extension<detail::merge_join_t> merge_join = {};
+}
+
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    merge_sorted.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_EXTENSIONS_MERGE_SORTED_H
+#define LINQ_GUARD_EXTENSIONS_MERGE_SORTED_H
+
+#include <linq/extensions/extension.h>
+#include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/ordered_range.h>
+#include <linq/extensions/detail/merged_range.h>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+#include <utility>
+#include <vector>
+
+namespace linq { 
+
+//
+// merge_sorted
+//
+// Merges ranges that are already sorted by the selector. It either merges a
+// range of sorted ranges, like the outputs of several shards:
+//
+//     shards | linq::merge_sorted(selector)
+//
+// or merges a range with up to four other ranges of the same type:
+//
+//     r1 | linq::merge_sorted(r2, r3, selector)
+//
+namespace detail {
+struct merge_sorted_t
+{
+    template<class Range>
+    static std::vector<std::pair
+    <
+        typename boost::range_iterator<const typename boost::range_value<Range>::type>::type,
+        typename boost::range_iterator<const typename boost::range_value<Range>::type>::type
+    > > 
+    nested_sources(const Range& r)
+    {
+        typedef typename boost::range_iterator<const typename boost::range_value<Range>::type>::type iterator;
+        std::vector<std::pair<iterator, iterator> > result;
+        for(auto it = boost::begin(r); it != boost::end(r); ++it) result.push_back(std::make_pair(boost::const_begin(*it), boost::const_end(*it)));
+        return result;
+    }
+
+    template<class Range, class... Ranges>
+    static std::vector<std::pair
+    <
+        typename boost::range_iterator<const Range>::type,
+        typename boost::range_iterator<const Range>::type
+    > > 
+    sources(const Range& r, const Ranges&... rs)
+    {
+        typedef typename boost::range_iterator<const Range>::type iterator;
+        std::pair<iterator, iterator> result[] = 
+        { 
+            std::make_pair(boost::const_begin(r), boost::const_end(r)), 
+            std::make_pair(boost::const_begin(rs), boost::const_end(rs))... 
+        };
+        return std::vector<std::pair<iterator, iterator> >(result, result + sizeof...(Ranges) + 1);
+    }
+
+    template<class Selector>
+    static auto merge_key(Selector s) LINQ_RETURNS
+    (make_ordering(make_order_key(make_function_object(s), ascending())));
+
+    template<class Range, class Selector>
+    auto operator()(Range && r, Selector s) const LINQ_RETURNS
+    (make_merged_range(nested_sources(r), merge_key(s)));
+
+    template<class Range1, class Range2, class Selector>
+    auto operator()(Range1 && r1, Range2 && r2, Selector s) const LINQ_RETURNS
+    (make_merged_range(sources(r1, r2), merge_key(s)));
+
+    template<class Range1, class Range2, class Range3, class Selector>
+    auto operator()(Range1 && r1, Range2 && r2, Range3 && r3, Selector s) const LINQ_RETURNS
+    (make_merged_range(sources(r1, r2, r3), merge_key(s)));
+
+    template<class Range1, class Range2, class Range3, class Range4, class Selector>
+    auto operator()(Range1 && r1, Range2 && r2, Range3 && r3, Range4 && r4, Selector s) const LINQ_RETURNS
+    (make_merged_range(sources(r1, r2, r3, r4), merge_key(s)));
+
+    template<class Range1, class Range2, class Range3, class Range4, class Range5, class Selector>
+    auto operator()(Range1 && r1, Range2 && r2, Range3 && r3, Range4 && r4, Range5 && r5, Selector s) const LINQ_RETURNS
+    (make_merged_range(sources(r1, r2, r3, r4, r5), merge_key(s)));
+};
+}
+namespace {
+range_extension<detail::merge_sorted_t> merge_sorted = {};
+}
+
+}
+
+#endif
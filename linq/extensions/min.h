@@ -11,6 +11,7 @@
 #include <linq/extensions/extension.h>
 #include <linq/extensions/aggregate.h>
 #include <linq/extensions/detail/defer.h>
+#include <linq/extensions/detail/simd.h>
 
 namespace linq { 
 namespace detail {
@@ -18,7 +19,7 @@ namespace detail {
 struct min_reducer
 {
     template<class T>
-    T operator()(T x, T y) const
+    const T& operator()(const T& x, const T& y) const
     {
         return (x < y) ? x : y;
     }
@@ -35,10 +36,22 @@ struct min_t
     {};
 
     template<class Range>
-    typename result<min_t(Range&&)>::type operator()(Range && r) const
+    static typename result<min_t(Range&&)>::type min(Range && r, boost::mpl::bool_<false>)
     {
         return r | linq::aggregate(defer<min_reducer>());
-    };
+    }
+
+    template<class Range>
+    static typename result<min_t(Range&&)>::type min(Range && r, boost::mpl::bool_<true>)
+    {
+        return simd_reduce<simd::min_op>(r, "linq::min failed");
+    }
+
+    template<class Range>
+    typename result<min_t(Range&&)>::type operator()(Range && r) const
+    {
+        return min_t::min(r, boost::mpl::bool_<is_simd_range<Range>::value and not is_fused_range<Range>::value>());
+    }
 };
 }
 namespace {
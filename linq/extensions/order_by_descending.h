@@ -9,27 +9,23 @@
 #define LINQ_GUARD_EXTENSIONS_ORDER_BY_DESCENDING_H
 
 #include <linq/extensions/extension.h>
-#include <linq/extensions/detail/defer.h>
+#include <linq/extensions/detail/function_object.h>
 #include <linq/extensions/detail/ordered_range.h>
-#include <linq/extensions/detail/placeholders.h>
 #include <boost/range.hpp>
+#include <boost/mpl/not.hpp>
 #include <linq/utility.h>
 
 namespace linq { 
 namespace detail {
-struct order_d_selector
-{
-    template<class Selector, class T>
-    bool operator()(Selector&& s, const T& x, const T& y) const
-    {
-        return s(x) > s(y);
-    }
-};
 struct order_by_descending_t
 {
     template<class Range, class Selector>
-    auto operator()(Range&& r, Selector s) const LINQ_RETURNS
-    (make_ordered_range(boost::begin(r), boost::end(r), std::bind(defer<order_d_selector>(), s, linq::_1, linq::_2)));
+    auto operator()(Range&& r, Selector s) const LINQ_RETURN_REQUIRES(boost::mpl::not_<is_fused_range<Range> >)
+    (make_ordered_range(boost::begin(r), boost::end(r), make_ordering(make_order_key(make_function_object(s), descending()))));
+
+    template<class Range, class Selector>
+    auto operator()(Range&& r, Selector s) const LINQ_RETURN_REQUIRES(is_fused_range<Range>)
+    (make_ordered_range(boost::begin(r), boost::end(r), make_ordering(make_order_key(make_function_object(s), descending())), r.policy));
 };
 }
 namespace {
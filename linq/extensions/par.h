@@ -0,0 +1,57 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    par.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_EXTENSIONS_PAR_H
+#define LINQ_GUARD_EXTENSIONS_PAR_H
+
+#include <linq/extensions/extension.h>
+#include <linq/extensions/detail/fused_range.h>
+#include <linq/extensions/detail/parallel_policy.h>
+#include <linq/thread_pool.h>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+#include <memory>
+#include <type_traits>
+
+namespace linq { 
+
+//
+// par
+//
+// Starts a fused pipeline that is run on several threads, when the range is
+// random access. The functions in the pipeline must be safe to call
+// concurrently, and the reducer given to aggregate must be associative, since
+// it is also used to combine the results from each thread. An aggregate with
+// a seed needs a combiner for the results from each thread instead, which
+// each start from a copy of the seed. By default the
+// pipeline runs on the shared thread_pool, `par(threads)` runs it on a new
+// pool with that many threads, and `par(executor)` runs it on any executor
+// with an `execute(f)` member function.
+//
+namespace detail {
+struct par_t
+{
+    template<class Range>
+    auto operator()(Range && r) const LINQ_RETURNS
+    (make_fused_range(boost::begin(r), boost::end(r), identity_stage(), boost::make_iterator_range(boost::begin(r), boost::end(r)), parallel_policy<>()));
+
+    template<class Range>
+    auto operator()(Range && r, unsigned threads) const LINQ_RETURNS
+    (make_fused_range(boost::begin(r), boost::end(r), identity_stage(), boost::make_iterator_range(boost::begin(r), boost::end(r)), parallel_policy<>(std::make_shared<thread_pool>(threads))));
+
+    template<class Range, class Executor>
+    auto operator()(Range && r, Executor& e) const LINQ_RETURN_REQUIRES(std::is_class<Executor>)
+    (make_fused_range(boost::begin(r), boost::end(r), identity_stage(), boost::make_iterator_range(boost::begin(r), boost::end(r)), parallel_policy<Executor>(e)));
+};
+}
+namespace {
+range_extension<detail::par_t, true> par = {};
+}
+
+}
+
+#endif
@@ -10,6 +10,7 @@
 
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <boost/iterator/transform_iterator.hpp>
 #include <boost/range.hpp>
 #include <linq/utility.h>
@@ -20,6 +21,47 @@ namespace linq {
 // select
 //
 namespace detail {
+
+template<class Selector, class Sink>
+struct select_sink
+{
+    Selector selector;
+    Sink sink;
+
+    select_sink(Selector selector, Sink sink)
+    : selector(selector), sink(sink)
+    {}
+
+    template<class T>
+    bool operator()(T && x)
+    {
+        return sink(selector(std::forward<T>(x)));
+    }
+};
+
+template<class Stage, class Selector>
+struct select_stage
+{
+    Stage stage;
+    Selector selector;
+
+    select_stage(Stage stage, Selector selector)
+    : stage(stage), selector(selector)
+    {}
+
+    template<class Iterator, class Sink>
+    bool push(Iterator first, Iterator last, Sink s) const
+    {
+        return stage.push(first, last, select_sink<Selector, Sink>(selector, s));
+    }
+};
+
+template<class Stage, class Selector>
+select_stage<Stage, Selector> make_select_stage(Stage stage, Selector selector)
+{
+    return select_stage<Stage, Selector>(stage, selector);
+}
+
 struct select_t
 {
     //TODO: make it work for empty and single ranges
@@ -39,7 +81,7 @@ struct select_t
     };
 
     template<class Range, class Selector>
-    typename result<select_t(Range&&, Selector)>::type operator()(Range && r, Selector selector) const
+    static typename result<select_t(Range&&, Selector)>::type make_select_range(Range && r, Selector selector)
     {
         return boost::make_iterator_range
         (
@@ -48,6 +90,17 @@ struct select_t
         ); 
     }
 
+    template<class Range, class Selector>
+    typename boost::lazy_disable_if<is_fused_range<Range>, result<select_t(Range&&, Selector)> >::type 
+    operator()(Range && r, Selector selector) const
+    {
+        return make_select_range(r, selector);
+    }
+
+    template<class Range, class Selector>
+    auto operator()(Range && r, Selector selector) const LINQ_RETURN_REQUIRES(is_fused_range<Range>)
+    (r.then(make_select_stage(r.stage, make_function_object(selector)), make_select_range(r.view, selector)));
+
 };
 }
 namespace {
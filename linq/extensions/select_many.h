@@ -10,6 +10,7 @@
 
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <boost/range.hpp>
 #include <boost/mpl/bool.hpp>
 
@@ -112,6 +113,52 @@ auto bind_range(Range && r, Selector s) LINQ_RETURNS
 );
 
 namespace detail {
+
+template<class Selector, class Sink>
+struct select_many_sink
+{
+    Selector selector;
+    Sink sink;
+
+    select_many_sink(Selector selector, Sink sink)
+    : selector(selector), sink(sink)
+    {}
+
+    template<class T>
+    bool operator()(T && x)
+    {
+        auto&& r = selector(std::forward<T>(x));
+        for(auto it = boost::begin(r); it != boost::end(r); ++it)
+        {
+            if (!sink(*it)) return false;
+        }
+        return true;
+    }
+};
+
+template<class Stage, class Selector>
+struct select_many_stage
+{
+    Stage stage;
+    Selector selector;
+
+    select_many_stage(Stage stage, Selector selector)
+    : stage(stage), selector(selector)
+    {}
+
+    template<class Iterator, class Sink>
+    bool push(Iterator first, Iterator last, Sink s) const
+    {
+        return stage.push(first, last, select_many_sink<Selector, Sink>(selector, s));
+    }
+};
+
+template<class Stage, class Selector>
+select_many_stage<Stage, Selector> make_select_many_stage(Stage stage, Selector selector)
+{
+    return select_many_stage<Stage, Selector>(stage, selector);
+}
+
 struct select_many_t
 {
     template<class>
@@ -125,10 +172,15 @@ struct select_many_t
         typedef boost::iterator_range<bind_iterator<iterator,  fun> > type;
     };
     template<class Range, class Selector>
-    typename result<select_many_t(Range&&, Selector)>::type operator()(Range && r, Selector s) const
+    typename boost::lazy_disable_if<is_fused_range<Range>, result<select_many_t(Range&&, Selector)> >::type 
+    operator()(Range && r, Selector s) const
     {
         return linq::bind_range(std::forward<Range>(r), make_function_object(s));
     };
+
+    template<class Range, class Selector>
+    auto operator()(Range && r, Selector s) const LINQ_RETURN_REQUIRES(is_fused_range<Range>)
+    (r.then(make_select_many_stage(r.stage, make_function_object(s)), linq::bind_range(r.view, make_function_object(s))));
 };
 }
 namespace {
@@ -0,0 +1,39 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    spill.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_EXTENSIONS_SPILL_H
+#define LINQ_GUARD_EXTENSIONS_SPILL_H
+
+#include <linq/extensions/extension.h>
+#include <linq/extensions/detail/ordered_range.h>
+#include <linq/extensions/detail/spilled_range.h>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+
+namespace linq { 
+
+//
+// spill
+//
+// Sorts an ordered range with at most about `budget` bytes of memory, by
+// writing sorted runs to temporary files and merging them while iterating.
+//
+namespace detail {
+struct spill_t
+{
+    template<class Range>
+    auto operator()(Range && r, std::size_t budget) const LINQ_RETURN_REQUIRES(is_ordered_range<Range>)
+    (make_spilled_range(r, budget));
+};
+}
+namespace {
+range_extension<detail::spill_t> spill = {};
+}
+
+}
+
+#endif
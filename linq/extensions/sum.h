@@ -11,6 +11,7 @@
 #include <linq/extensions/extension.h>
 #include <linq/extensions/aggregate.h>
 #include <linq/extensions/detail/defer.h>
+#include <linq/extensions/detail/simd.h>
 
 namespace linq { 
 namespace detail {
@@ -35,10 +36,24 @@ struct sum_t
     {};
 
     template<class Range>
-    typename result<sum_t(Range&&)>::type operator()(Range && r) const
+    static typename result<sum_t(Range&&)>::type sum(Range && r, boost::mpl::bool_<false>)
     {
         return (r | linq::aggregate(defer<sum_reducer>()));
     }
+
+    // Contiguous ranges of int, float and double are added with vector
+    // instructions
+    template<class Range>
+    static typename result<sum_t(Range&&)>::type sum(Range && r, boost::mpl::bool_<true>)
+    {
+        return simd_reduce<simd::sum_op>(r, "linq::sum failed");
+    }
+
+    template<class Range>
+    typename result<sum_t(Range&&)>::type operator()(Range && r) const
+    {
+        return sum_t::sum(r, boost::mpl::bool_<is_simd_range<Range>::value and not is_fused_range<Range>::value>());
+    }
 };
 }
 namespace {
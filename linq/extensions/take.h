@@ -9,14 +9,23 @@
 #define LINQ_GUARD_EXTENSIONS_TAKE_H
 
 #include <linq/extensions/extension.h>
+#include <linq/extensions/detail/ordered_range.h>
 #include <boost/range.hpp>
+#include <boost/mpl/not.hpp>
 
 namespace linq { 
 namespace detail {
 struct take_t
 {
     template<class Range>
-    auto operator()(Range && r, long count) const LINQ_RETURNS(boost::make_iterator_range(boost::begin(r), boost::next(boost::begin(r), count)));
+    auto operator()(Range && r, long count) const LINQ_RETURN_REQUIRES(boost::mpl::not_<is_ordered_range<Range> >)
+    (boost::make_iterator_range(boost::begin(r), boost::next(boost::begin(r), count)));
+
+    // An ordered range only selects the first elements, instead of sorting
+    // all of them
+    template<class Range>
+    auto operator()(Range && r, long count) const LINQ_RETURN_REQUIRES(is_ordered_range<Range>)
+    (r.take(count));
 };
 }
 namespace {
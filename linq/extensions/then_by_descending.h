@@ -9,30 +9,19 @@
 #define LINQ_GUARD_EXTENSIONS_THEN_BY_DESCENDING_H
 
 #include <linq/extensions/extension.h>
-#include <linq/extensions/detail/defer.h>
+#include <linq/extensions/detail/function_object.h>
 #include <linq/extensions/detail/ordered_range.h>
-#include <linq/extensions/detail/placeholders.h>
 #include <boost/range.hpp>
 #include <linq/utility.h>
 
 namespace linq { 
 namespace detail {
 
-struct then_d_selector
-{
-    template<class Selector, class Compare, class T>
-    bool operator()(Selector&& s, Compare&& c, const T& x, const T& y) const
-    {
-        bool first = c(x, y);
-        return (first || c(y, x)) ? first : s(x) > s(y);
-    }
-};
-
 struct then_by_descending_t
 {
     template<class Range, class Selector>
     auto operator()(Range&& r, Selector s) const LINQ_RETURNS
-    (make_ordered_range(r.first, r.last, std::bind(defer<then_d_selector>(), s, r.c, linq::_1, linq::_2)));
+    (r.then(r.key.then(make_order_key(make_function_object(s), descending()))));
 };
 }
 namespace {
@@ -9,7 +9,9 @@
 #define LINQ_GUARD_EXTENSIONS_TO_CONTAINER_H
 
 #include <linq/extensions/extension.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <boost/range.hpp>
+#include <iterator>
 
 namespace linq { 
 
@@ -36,9 +38,71 @@ struct to_container_t
         }
     };
 
+    template<class Container>
+    struct buffer_sink
+    {
+        Container c;
+
+        template<class T>
+        bool operator()(T && x)
+        {
+            c.insert(c.end(), std::forward<T>(x));
+            return true;
+        }
+    };
+
+    template<class Container>
+    struct insert_sink
+    {
+        Container * c;
+
+        insert_sink(Container& c) : c(&c)
+        {}
+
+        template<class T>
+        bool operator()(T && x)
+        {
+            c->insert(c->end(), std::forward<T>(x));
+            return true;
+        }
+
+        buffer_sink<Container> split() const
+        {
+            return buffer_sink<Container>();
+        }
+
+        void join(buffer_sink<Container>& other)
+        {
+            c->insert(c->end(), std::make_move_iterator(other.c.begin()), std::make_move_iterator(other.c.end()));
+        }
+    };
+
     template<class Range>
-    auto operator()(Range && r) const LINQ_RETURNS
+    struct fused_converter
+    {
+        Range r;
+
+        template<class R>
+        fused_converter(R && x) : r(std::forward<R&&>(x))
+        {}
+
+        template<class C>
+        operator C() const
+        {
+            C c;
+            insert_sink<C> sink(c);
+            r.push(sink);
+            return c;
+        }
+    };
+
+    template<class Range>
+    auto operator()(Range && r) const LINQ_RETURN_REQUIRES(boost::mpl::not_<is_fused_range<Range> >)
     (converter<Range&&>(std::forward<Range>(r)));
+
+    template<class Range>
+    auto operator()(Range && r) const LINQ_RETURN_REQUIRES(is_fused_range<Range>)
+    (fused_converter<typename std::decay<Range>::type>(std::forward<Range>(r)));
 };
 }
 namespace {
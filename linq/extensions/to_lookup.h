@@ -0,0 +1,44 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    to_lookup.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef LINQ_GUARD_EXTENSIONS_TO_LOOKUP_H
+#define LINQ_GUARD_EXTENSIONS_TO_LOOKUP_H
+
+#include <linq/extensions/extension.h>
+#include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/identity.h>
+#include <linq/extensions/detail/lookup.h>
+#include <boost/range.hpp>
+#include <linq/utility.h>
+
+namespace linq { 
+
+//
+// to_lookup
+//
+// Groups the range like group_by, but into a lookup, where each key is
+// stored once and the values of each group are contiguous.
+//
+namespace detail {
+struct to_lookup_t
+{
+    template<class Range, class KeySelector>
+    auto operator()(Range && r, KeySelector ks) const LINQ_RETURNS
+    (make_lookup(r, make_function_object(ks), identity_selector()));
+
+    template<class Range, class KeySelector, class ElementSelector>
+    auto operator()(Range && r, KeySelector ks, ElementSelector es) const LINQ_RETURNS
+    (make_lookup(r, make_function_object(ks), make_function_object(es)));
+};
+}
+namespace {
+range_extension<detail::to_lookup_t> to_lookup = {};
+}
+
+}
+
+#endif
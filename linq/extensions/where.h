@@ -10,17 +10,107 @@
 
 #include <linq/extensions/extension.h>
 #include <linq/extensions/detail/function_object.h>
+#include <linq/extensions/detail/fused_range.h>
 #include <boost/iterator/filter_iterator.hpp>
+#include <boost/iterator/iterator_categories.hpp>
 #include <boost/range.hpp>
 #include <linq/utility.h>
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#ifndef LINQ_WHERE_BATCH
+#define LINQ_WHERE_BATCH 1024
+#endif
 
 namespace linq { 
 
 namespace detail {
+
+template<class Predicate, class Sink>
+struct where_sink
+{
+    Predicate p;
+    Sink sink;
+
+    where_sink(Predicate p, Sink sink)
+    : p(p), sink(sink)
+    {}
+
+    template<class T>
+    bool operator()(T && x)
+    {
+        return p(x) ? sink(std::forward<T>(x)) : true;
+    }
+};
+
+template<class Stage, class Predicate>
+struct where_stage
+{
+    Stage stage;
+    Predicate p;
+
+    where_stage(Stage stage, Predicate p)
+    : stage(stage), p(p)
+    {}
+
+    template<class Iterator, class Sink, class Traversal>
+    bool push(Iterator first, Iterator last, Sink s, Traversal) const
+    {
+        return stage.push(first, last, where_sink<Predicate, Sink>(p, s));
+    }
+
+    // When the where is applied directly to a random access source, the
+    // predicate is evaluated over a batch of elements first, and the indices
+    // of the elements that pass are compacted into a selection vector without
+    // branching on the result. Then only the selected elements are pushed
+    // into the sink. So the predicate can be called on the rest of a batch
+    // after the sink stops.
+    template<class Iterator, class Sink>
+    bool push(Iterator first, Iterator last, Sink s, boost::random_access_traversal_tag) const
+    {
+        std::size_t selection[LINQ_WHERE_BATCH];
+        while (first != last)
+        {
+            std::size_t n = std::min<std::size_t>(last - first, LINQ_WHERE_BATCH);
+            std::size_t selected = 0;
+            for(std::size_t i = 0; i < n; i++)
+            {
+                selection[selected] = i;
+                selected += p(first[i]) ? 1 : 0;
+            }
+            for(std::size_t i = 0; i < selected; i++)
+            {
+                if (!s(first[selection[i]])) return false;
+            }
+            first += n;
+        }
+        return true;
+    }
+
+    template<class Iterator, class Sink>
+    bool push(Iterator first, Iterator last, Sink s) const
+    {
+        typedef typename boost::iterator_traversal<Iterator>::type traversal;
+        return this->push(first, last, s, typename std::conditional
+        <
+            std::is_same<Stage, identity_stage>::value,
+            traversal,
+            boost::incrementable_traversal_tag
+        >::type());
+    }
+};
+
+template<class Stage, class Predicate>
+where_stage<Stage, Predicate> make_where_stage(Stage stage, Predicate p)
+{
+    return where_stage<Stage, Predicate>(stage, p);
+}
+
 struct where_t
 {
     template<class Range, class Predicate>
-    auto operator()(Range && r, Predicate p) const LINQ_RETURNS
+    static auto make_where_range(Range && r, Predicate p) LINQ_RETURNS
     (
         boost::make_iterator_range
         (
@@ -28,6 +118,14 @@ struct where_t
             boost::make_filter_iterator(make_function_object(p), boost::end(r), boost::end(r))
         )
     );
+
+    template<class Range, class Predicate>
+    auto operator()(Range && r, Predicate p) const LINQ_RETURN_REQUIRES(boost::mpl::not_<is_fused_range<Range> >)
+    (make_where_range(r, p));
+
+    template<class Range, class Predicate>
+    auto operator()(Range && r, Predicate p) const LINQ_RETURN_REQUIRES(is_fused_range<Range>)
+    (r.then(make_where_stage(r.stage, make_function_object(p)), make_where_range(r.view, p)));
 };
 }
 namespace {
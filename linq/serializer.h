@@ -0,0 +1,164 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    serializer.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef INCLUDE_GUARD_LINQ_SERIALIZER_H
+#define INCLUDE_GUARD_LINQ_SERIALIZER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace linq {
+
+//
+// serializer
+//
+// Writes values to a file and reads them back, which is used by the
+// extensions that spill to temporary files. It can be specialized for other
+// types with the same static member functions:
+//
+//     static void write(std::FILE * f, const T& x);
+//     static bool read(std::FILE * f, T& x); // Returns false at the end of the file
+//                                            // and throws if x is cut short
+//     static std::size_t size(const T& x); // The memory used by x, in bytes
+//
+// Trivially copyable types are written as they are, and there are
+// specializations for strings, pairs and vectors.
+//
+namespace detail {
+
+inline void serializer_write(std::FILE * f, const void * p, std::size_t n)
+{
+    if (n > 0 and std::fwrite(p, 1, n, f) != n) throw std::runtime_error("linq::serializer failed to write");
+}
+
+// Returns false at the end of the file, when nothing is left to read. A read
+// error, or a value that is cut short, throws instead, so a truncated or
+// corrupt file doesn't silently lose values.
+inline bool serializer_read(std::FILE * f, void * p, std::size_t n)
+{
+    if (n == 0) return true;
+    std::size_t read = std::fread(p, 1, n, f);
+    if (read == n) return true;
+    if (std::ferror(f)) throw std::runtime_error("linq::serializer failed to read");
+    if (read > 0) throw std::runtime_error("linq::serializer read a truncated value");
+    return false;
+}
+
+// Reads the rest of a value, where the end of the file means that it was cut
+// short
+inline void serializer_read_rest(bool read)
+{
+    if (!read) throw std::runtime_error("linq::serializer read a truncated value");
+}
+
+}
+
+template<class T, class Enable = void>
+struct serializer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Specialize linq::serializer to write this type to a file");
+
+    static void write(std::FILE * f, const T& x)
+    {
+        detail::serializer_write(f, &x, sizeof(T));
+    }
+
+    static bool read(std::FILE * f, T& x)
+    {
+        return detail::serializer_read(f, &x, sizeof(T));
+    }
+
+    static std::size_t size(const T&)
+    {
+        return sizeof(T);
+    }
+};
+
+template<class Char, class Traits, class Allocator>
+struct serializer<std::basic_string<Char, Traits, Allocator> >
+{
+    typedef std::basic_string<Char, Traits, Allocator> string_type;
+
+    static void write(std::FILE * f, const string_type& x)
+    {
+        std::size_t n = x.size();
+        detail::serializer_write(f, &n, sizeof(n));
+        detail::serializer_write(f, x.data(), n * sizeof(Char));
+    }
+
+    static bool read(std::FILE * f, string_type& x)
+    {
+        std::size_t n = 0;
+        if (!detail::serializer_read(f, &n, sizeof(n))) return false;
+        x.resize(n);
+        if (n > 0) detail::serializer_read_rest(detail::serializer_read(f, &x[0], n * sizeof(Char)));
+        return true;
+    }
+
+    static std::size_t size(const string_type& x)
+    {
+        return sizeof(string_type) + x.capacity() * sizeof(Char);
+    }
+};
+
+template<class T, class U>
+struct serializer<std::pair<T, U> >
+{
+    static void write(std::FILE * f, const std::pair<T, U>& x)
+    {
+        serializer<T>::write(f, x.first);
+        serializer<U>::write(f, x.second);
+    }
+
+    static bool read(std::FILE * f, std::pair<T, U>& x)
+    {
+        if (!serializer<T>::read(f, x.first)) return false;
+        detail::serializer_read_rest(serializer<U>::read(f, x.second));
+        return true;
+    }
+
+    static std::size_t size(const std::pair<T, U>& x)
+    {
+        return serializer<T>::size(x.first) + serializer<U>::size(x.second);
+    }
+};
+
+template<class T, class Allocator>
+struct serializer<std::vector<T, Allocator> >
+{
+    static void write(std::FILE * f, const std::vector<T, Allocator>& x)
+    {
+        std::size_t n = x.size();
+        detail::serializer_write(f, &n, sizeof(n));
+        for(std::size_t i = 0; i < n; i++) serializer<T>::write(f, x[i]);
+    }
+
+    static bool read(std::FILE * f, std::vector<T, Allocator>& x)
+    {
+        std::size_t n = 0;
+        if (!detail::serializer_read(f, &n, sizeof(n))) return false;
+        x.resize(n);
+        for(std::size_t i = 0; i < n; i++) detail::serializer_read_rest(serializer<T>::read(f, x[i]));
+        return true;
+    }
+
+    static std::size_t size(const std::vector<T, Allocator>& x)
+    {
+        std::size_t result = sizeof(x) + (x.capacity() - x.size()) * sizeof(T);
+        for(std::size_t i = 0; i < x.size(); i++) result += serializer<T>::size(x[i]);
+        return result;
+    }
+};
+
+}
+
+#endif
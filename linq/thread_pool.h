@@ -0,0 +1,282 @@
+/*=============================================================================
+    Copyright (c) 2012 Paul Fultz II
+    thread_pool.h
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+==============================================================================*/
+
+#ifndef INCLUDE_GUARD_LINQ_THREAD_POOL_H
+#define INCLUDE_GUARD_LINQ_THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace linq {
+
+//
+// thread_pool
+//
+// A work stealing thread pool. Each worker has its own deque of tasks. A
+// worker pushes and pops the tasks it submits at the back of its own deque,
+// and when it runs out of tasks it steals from the front of the other
+// deques, which is where the largest pieces of a recursively split range
+// are. Tasks submitted from outside the pool are spread across the deques.
+//
+// Any other executor can be used instead of the pool, as long as it has an
+// `execute(f)` member function that eventually calls `f()` on some thread.
+//
+class thread_pool
+{
+    struct worker_queue
+    {
+        std::mutex m;
+        std::deque<std::function<void()> > tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue> > queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> pending;
+    std::atomic<std::size_t> next;
+    std::mutex m;
+    std::condition_variable cv;
+    bool done;
+
+    struct worker_id
+    {
+        const thread_pool * pool;
+        std::size_t index;
+    };
+
+    static worker_id& current()
+    {
+        static thread_local worker_id id = { nullptr, 0 };
+        return id;
+    }
+
+    bool pop(std::size_t i, std::function<void()>& task)
+    {
+        worker_queue& q = *queues[i];
+        std::lock_guard<std::mutex> lk(q.m);
+        if (q.tasks.empty()) return false;
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        pending--;
+        return true;
+    }
+
+    bool steal(std::size_t i, std::function<void()>& task)
+    {
+        for(std::size_t j = 1; j < queues.size(); j++)
+        {
+            worker_queue& q = *queues[(i + j) % queues.size()];
+            std::lock_guard<std::mutex> lk(q.m);
+            if (q.tasks.empty()) continue;
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            pending--;
+            return true;
+        }
+        return false;
+    }
+
+    void work(std::size_t i)
+    {
+        current().pool = this;
+        current().index = i;
+        std::function<void()> task;
+        while(true)
+        {
+            if (this->pop(i, task) or this->steal(i, task))
+            {
+                task();
+                task = nullptr;
+            }
+            else
+            {
+                std::unique_lock<std::mutex> lk(m);
+                cv.wait(lk, [this] { return done or pending > 0; });
+                if (done and pending == 0) return;
+            }
+        }
+    }
+
+    thread_pool(const thread_pool&);
+    thread_pool& operator=(const thread_pool&);
+public:
+    explicit thread_pool(unsigned threads = std::thread::hardware_concurrency())
+    : pending(0), next(0), done(false)
+    {
+        if (threads == 0) threads = 1;
+        for(unsigned i = 0; i < threads; i++) queues.emplace_back(new worker_queue());
+        for(unsigned i = 0; i < threads; i++) workers.emplace_back([this, i] { this->work(i); });
+    }
+
+    // Runs the tasks that are still queued before joining the workers
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            done = true;
+        }
+        cv.notify_all();
+        for(std::size_t i = 0; i < workers.size(); i++) workers[i].join();
+    }
+
+    // The task must not throw
+    void execute(std::function<void()> task)
+    {
+        std::size_t i = current().pool == this ? current().index : next++ % queues.size();
+        {
+            std::lock_guard<std::mutex> lk(queues[i]->m);
+            queues[i]->tasks.push_back(std::move(task));
+            pending++;
+        }
+        {
+            std::lock_guard<std::mutex> lk(m);
+        }
+        cv.notify_one();
+    }
+
+    // Runs one queued task on the calling thread. Returns false if there
+    // wasn't any task to run.
+    bool run_pending_task()
+    {
+        std::size_t i = current().pool == this ? current().index : 0;
+        std::function<void()> task;
+        if (this->pop(i, task) or this->steal(i, task))
+        {
+            task();
+            return true;
+        }
+        return false;
+    }
+
+    std::size_t size() const
+    {
+        return workers.size();
+    }
+
+    // The pool used by the parallel extensions when no executor is given
+    static thread_pool& instance()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+};
+
+//
+// parallel_for
+//
+// Calls body(i) for each i in [first, last) using the executor. The range is
+// split in half recursively, and one half is submitted to the executor while
+// the other half keeps being split on the current thread, so idle workers
+// can steal large pieces of work. The calling thread waits until every call
+// is done, and helps run the queued tasks when the executor is a
+// thread_pool. The first exception thrown by the body is rethrown.
+//
+namespace detail {
+
+template<class Executor, class Body>
+struct fork_join
+{
+    Executor& executor;
+    Body& body;
+    std::size_t remaining;
+    std::atomic<bool> failed;
+    std::exception_ptr error;
+    std::mutex m;
+    std::condition_variable cv;
+
+    fork_join(Executor& executor, Body& body, std::size_t n)
+    : executor(executor), body(body), remaining(n), failed(false)
+    {}
+
+    void split(std::size_t first, std::size_t last)
+    {
+        while (last - first > 1)
+        {
+            std::size_t middle = first + (last - first) / 2;
+            executor.execute([this, middle, last] { this->split(middle, last); });
+            last = middle;
+        }
+        this->run(first);
+    }
+
+    void run(std::size_t i)
+    {
+        if (!failed)
+        {
+            try
+            {
+                body(i);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lk(m);
+                if (!failed) error = std::current_exception();
+                failed = true;
+            }
+        }
+        std::lock_guard<std::mutex> lk(m);
+        if (--remaining == 0) cv.notify_all();
+    }
+
+    template<class E>
+    void wait(E&)
+    {
+        std::unique_lock<std::mutex> lk(m);
+        cv.wait(lk, [this] { return remaining == 0; });
+    }
+
+    void wait(thread_pool& pool)
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lk(m);
+                if (remaining == 0) return;
+            }
+            if (!pool.run_pending_task())
+            {
+                std::unique_lock<std::mutex> lk(m);
+                cv.wait_for(lk, std::chrono::milliseconds(1), [this] { return remaining == 0; });
+            }
+        }
+    }
+};
+
+template<class Executor>
+std::size_t executor_concurrency(const Executor&)
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+inline std::size_t executor_concurrency(const thread_pool& pool)
+{
+    return pool.size() + 1;
+}
+
+}
+
+template<class Executor, class Body>
+void parallel_for(Executor& executor, std::size_t first, std::size_t last, Body body)
+{
+    if (first >= last) return;
+    detail::fork_join<Executor, Body> job(executor, body, last - first);
+    job.split(first, last);
+    job.wait(executor);
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+}
+
+#endif
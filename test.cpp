@@ -1,6 +1,7 @@
 
 #include <linq/extensions.h>
 #include <linq/query.h>
+#include <linq/thread_pool.h>
 
 #include <boost/assign.hpp>
 #include <string>
@@ -66,6 +67,8 @@ struct odd
     }
 };
 
+enum class weekday { mon, tue, wed, thu, fri, sat, sun };
+
 struct person
 {
     std::string name;
@@ -78,6 +81,28 @@ struct person
     {}
 };
 
+namespace linq {
+template<>
+struct serializer<person>
+{
+    static void write(std::FILE * f, const person& p)
+    {
+        serializer<std::string>::write(f, p.name);
+        serializer<int>::write(f, p.age);
+    }
+
+    static bool read(std::FILE * f, person& p)
+    {
+        return serializer<std::string>::read(f, p.name) and serializer<int>::read(f, p.age);
+    }
+
+    static std::size_t size(const person& p)
+    {
+        return sizeof(person) + p.name.capacity();
+    }
+};
+}
+
 struct student
 {
     std::string name;
@@ -103,6 +128,15 @@ struct pet
     {}
 };
 
+struct inline_executor
+{
+    template<class F>
+    void execute(F f)
+    {
+        f();
+    }
+};
+
 struct name_selector
 {
     template<class T>
@@ -275,6 +309,20 @@ BOOST_AUTO_TEST_CASE( distinct_test )
     std::vector<int> v = list_of(1)(2)(2)(3)(2)(4)(5)(5);
     std::vector<int> d = list_of(1)(2)(3)(4)(5);
     CHECK_SEQ(d, v | linq::distinct);
+
+    std::vector<std::string> s;
+    std::vector<std::string> ds;
+    for(int i = 0; i < 3000; i++) s.push_back(std::to_string(i % 700));
+    for(int i = 0; i < 700; i++) ds.push_back(std::to_string(i));
+    CHECK_SEQ(ds, s | linq::distinct);
+
+    // Small integer keys are indexed directly, until one is too far away
+    std::vector<long> n = list_of(-3)(7)(-3)(-100)(7)(2000000000)(-100)(5)(2000000000);
+    std::vector<long> dn = list_of(-3)(7)(-100)(2000000000)(5);
+    CHECK_SEQ(dn, n | linq::distinct);
+    std::vector<weekday> w = list_of(weekday::fri)(weekday::mon)(weekday::fri)(weekday::sun)(weekday::mon);
+    std::vector<weekday> dw = list_of(weekday::fri)(weekday::mon)(weekday::sun);
+    BOOST_CHECK(w | linq::distinct | linq::sequence_equal(dw));
 }
 
 BOOST_AUTO_TEST_CASE( element_at_test )
@@ -289,6 +337,11 @@ BOOST_AUTO_TEST_CASE( except_test )
     std::vector<int> v2 = list_of(2)(4);
     std::vector<int> e = list_of(1)(3)(5);
     BOOST_CHECK(v1 | linq::except(v2) | linq::sequence_equal(e));
+
+    std::vector<unsigned> u1 = list_of(70000)(3)(4294967295u)(3)(9);
+    std::vector<unsigned> u2 = list_of(4294967295u)(9);
+    std::vector<unsigned> eu = list_of(70000)(3);
+    CHECK_SEQ(eu, u1 | linq::except(u2));
 }
 
 BOOST_AUTO_TEST_CASE( find_test )
@@ -320,6 +373,44 @@ BOOST_AUTO_TEST_CASE( first_or_default_test )
     BOOST_CHECK_EQUAL(3, v | linq::first_or_default(odd()));
     BOOST_CHECK_EQUAL(0, v | linq::first_or_default([](int x) { return x > 5; }));
 }
+
+BOOST_AUTO_TEST_CASE( fused_test )
+{
+    std::vector<int> v = list_of(1)(2)(3)(4)(5)(6);
+    std::vector<int> r = list_of(3)(9)(15);
+    auto times_3 = [](int x) { return x * 3; };
+
+    BOOST_CHECK_EQUAL(27, v | linq::fused | linq::where(odd()) | linq::select(times_3) | linq::sum);
+    BOOST_CHECK_EQUAL(3, v | linq::fused | linq::where(odd()) | linq::select(times_3) | linq::min);
+    BOOST_CHECK_EQUAL(15, v | linq::fused | linq::where(odd()) | linq::select(times_3) | linq::max);
+    BOOST_CHECK_EQUAL(3, v | linq::fused | linq::where(odd()) | linq::count);
+    BOOST_CHECK_EQUAL(2, v | linq::fused | linq::select(times_3) | linq::count([](int x) { return x > 12; }));
+    BOOST_CHECK_EQUAL(10, v | linq::fused | linq::where(odd()) | linq::aggregate(1, [](int x, int y) { return x + y; }));
+    BOOST_CHECK(v | linq::fused | linq::any([](int x) { return x > 5; }));
+    BOOST_CHECK(!(v | linq::fused | linq::where(odd()) | linq::any([](int x) { return x > 5; })));
+    BOOST_CHECK(v | linq::fused | linq::where(odd()) | linq::all(odd()));
+    BOOST_CHECK(!(v | linq::fused | linq::all(odd())));
+
+    std::list<int> l = v | linq::fused | linq::where(odd()) | linq::select(times_3) | linq::to_container;
+    CHECK_SEQ(r, l);
+    CHECK_SEQ(r, v | linq::fused | linq::where(odd()) | linq::select(times_3));
+
+    std::vector<student> students = list_of
+    (student("Bob", list_of(90)(100)(75)))
+    (student("Tom", list_of(92)(81)(70)));
+    BOOST_CHECK_EQUAL(508, students | linq::fused | linq::select_many([](student& s) { return std::ref(s.grades); }) | linq::sum);
+    BOOST_CHECK_EQUAL(2, students | linq::fused | linq::select_many([](student& s) { return std::ref(s.grades); }) | linq::count([](int g) { return g > 90; }));
+
+    // Longer than a batch of where
+    std::vector<int> big;
+    for(int i = 0; i < 3000; i++) big.push_back(i);
+    std::vector<int> big_odds = big | linq::fused | linq::where(odd()) | linq::to_container;
+    CHECK_SEQ(big | linq::where(odd()), big_odds);
+    BOOST_CHECK_EQUAL(big | linq::where(odd()) | linq::select(times_3) | linq::sum, big | linq::fused | linq::where(odd()) | linq::select(times_3) | linq::sum);
+    BOOST_CHECK_EQUAL(1500, big | linq::fused | linq::where(odd()) | linq::count);
+    BOOST_CHECK(big | linq::fused | linq::where(odd()) | linq::any([](int x) { return x > 2500; }));
+    BOOST_CHECK(!(big | linq::fused | linq::where(odd()) | linq::any([](int x) { return x % 2 == 0; })));
+}
 #ifndef _MSC_VER
 BOOST_AUTO_TEST_CASE( group_by_test )
 {
@@ -338,8 +429,134 @@ BOOST_AUTO_TEST_CASE( group_by_test )
     BOOST_CHECK_EQUAL("Terry", q.equal_range(37).first->second);
     BOOST_CHECK(q.equal_range(22) | linq::values | linq::contains("Bob") );
     BOOST_CHECK(q.equal_range(22) | linq::values | linq::contains("Jerry") );
+    BOOST_CHECK_EQUAL(0, boost::distance(q.equal_range(30)));
+    BOOST_CHECK_EQUAL(2, q.count(22));
+
+    // The elements of a group are next to each other, in the order of the source
+    std::vector<int> big;
+    for(int i = 0; i < 5000; i++) big.push_back((i * 7919) % 5000);
+    auto g = big | linq::group_by([](int x) { return x % 1000; });
+    BOOST_CHECK_EQUAL(5000, g.size());
+    for(int k = 0; k < 1000; k++)
+    {
+        auto r = g.equal_range(k);
+        std::vector<int> expected = big | linq::where([k](int x) { return x % 1000 == k; }) | linq::to_container;
+        CHECK_SEQ(expected, r | linq::values);
+    }
+    // The groups are in the order that their keys first appear
+    std::vector<int> first_seen = big | linq::select([](int x) { return x % 1000; }) | linq::distinct | linq::to_container;
+    CHECK_SEQ(first_seen, g.keys());
+    CHECK_SEQ(first_seen, g | linq::keys | linq::distinct);
+    int last = first_seen.back();
+    CHECK_SEQ(big | linq::where([last](int x) { return x % 1000 == last; }), boost::make_iterator_range(g.group(first_seen.size() - 1)) | linq::values);
+    std::vector<int> empty;
+    BOOST_CHECK(boost::empty(empty | linq::group_by([](int x) { return x; })));
+
+    // After par, the tables of each thread are joined in the order of the source
+    std::vector<int> many;
+    for(int i = 0; i < 100000; i++) many.push_back((i * 7919) % 100000);
+    auto mod = [](int x) { return x % 1000; };
+    auto half = [](int x) { return x / 2; };
+    auto seq = many | linq::group_by(mod, half);
+    auto par = many | linq::par | linq::group_by(mod, half);
+    auto fused = many | linq::fused | linq::where(odd()) | linq::group_by(mod);
+    CHECK_SEQ(seq | linq::keys, par | linq::keys);
+    CHECK_SEQ(seq | linq::values, par | linq::values);
+    BOOST_CHECK_EQUAL(50000, fused.size());
+    CHECK_SEQ(many | linq::where(odd()) | linq::where([](int x) { return x % 1000 == 7; }), fused.equal_range(7) | linq::values);
+
+    // Keys that start out close together, and then spread out
+    auto spread = [](int x) { return x < 50000 ? x % 100 : x * 10; };
+    auto s = many | linq::group_by(spread);
+    BOOST_CHECK_EQUAL(100 + 50000, boost::distance(s | linq::keys | linq::distinct));
+    BOOST_CHECK_EQUAL(500, s.count(42));
+    BOOST_CHECK_EQUAL(1, s.count(999990));
+    BOOST_CHECK_EQUAL(0, s.count(1000));
+}
 
+BOOST_AUTO_TEST_CASE( group_by_ref_test )
+{
+    std::vector<person> v = list_of
+    (person("Tom", 25))
+    (person("Bob", 22))
+    (person("Terry", 37))
+    (person("Jerry", 22));
+
+    auto q = v | linq::group_by_ref([](const person& p) { return p.age; });
+    BOOST_CHECK_EQUAL(3, q.size());
+    std::vector<int> keys = list_of(25)(22)(37);
+    CHECK_SEQ(keys, q.keys());
+    std::vector<std::string> names = list_of("Bob")("Jerry");
+    CHECK_SEQ(names, q[22] | linq::select([](const person& p) { return p.name; }));
+    BOOST_CHECK(boost::empty(q[30]));
+    BOOST_CHECK_EQUAL(37, q.find(37)->key());
+
+    // The groups refer to the elements of the source
+    BOOST_CHECK_EQUAL(&v[3], &*boost::next(boost::begin(q[22])));
+    q[22].front().age = 23;
+    BOOST_CHECK_EQUAL(23, v[1].age);
+
+    std::list<int> l;
+    for(int i = 0; i < 1000; i++) l.push_back((i * 7919) % 1000);
+    auto lq = l | linq::group_by_ref([](int x) { return x % 10; });
+    BOOST_CHECK_EQUAL(10, lq.size());
+    for(auto&& g : lq)
+    {
+        std::vector<int> expected = l | linq::where([&g](int x) { return x % 10 == g.key(); }) | linq::to_container;
+        CHECK_SEQ(expected, g);
+    }
+}
+#endif
+#ifndef _MSC_VER
+BOOST_AUTO_TEST_CASE( group_aggregate_test )
+{
+    std::vector<person> v = list_of
+    (person("Tom", 25))
+    (person("Bob", 22))
+    (person("Terry", 37))
+    (person("Jerry", 22));
 
+    auto age_select = [](const person& p) { return p.age; };
+    auto count = [](int n, const person&) { return n + 1; };
+    auto q = v | linq::group_aggregate(age_select, 0, count);
+    BOOST_CHECK_EQUAL(3, q.size());
+    BOOST_CHECK_EQUAL(2, q.at(22));
+    BOOST_CHECK_EQUAL(1, q.at(37));
+    BOOST_CHECK_EQUAL(0, q.count(30));
+    BOOST_CHECK_THROW(q.at(30), std::out_of_range);
+    BOOST_CHECK(q.find(30) == q.end());
+    BOOST_CHECK_EQUAL(2, q.find(22)->second);
+    std::vector<int> keys = list_of(25)(22)(37);
+    std::vector<int> counts = list_of(1)(2)(1);
+    CHECK_SEQ(keys, q | linq::keys);
+    CHECK_SEQ(counts, q | linq::values);
+
+    auto names = v | linq::group_aggregate(age_select, std::string(), [](std::string s, const person& p) { return s + p.name; });
+    BOOST_CHECK_EQUAL("BobJerry", names.at(22));
+
+    // The partial maps of each thread are combined
+    std::vector<int> big;
+    for(int i = 0; i < 100000; i++) big.push_back(i);
+    auto mod = [](int x) { return x % 97; };
+    auto sums = big | linq::group_aggregate(mod, 0L, [](long s, int x) { return s + x; });
+    auto fused_sums = big | linq::fused | linq::where(odd()) | linq::group_aggregate(mod, 0L, [](long s, int x) { return s + x; });
+    auto par_sums = big | linq::par | linq::group_aggregate(mod, 0L, [](long s, int x) { return s + x; }, std::plus<long>());
+    auto par_counts = big | linq::par | linq::group_aggregate(mod, 0, [](int n, int) { return n + 1; }, std::plus<int>());
+    BOOST_CHECK_EQUAL(97, par_sums.size());
+    for(int k = 0; k < 97; k++)
+    {
+        long expected = 0;
+        long expected_odd = 0;
+        for(int i = k; i < 100000; i += 97) 
+        {
+            expected += i;
+            if (i % 2 == 1) expected_odd += i;
+        }
+        BOOST_CHECK_EQUAL(expected, sums.at(k));
+        BOOST_CHECK_EQUAL(expected_odd, fused_sums.at(k));
+        BOOST_CHECK_EQUAL(expected, par_sums.at(k));
+        BOOST_CHECK_EQUAL((100000 - k + 96) / 97, par_counts.at(k));
+    }
 }
 #endif
 struct group_join_select
@@ -439,6 +656,82 @@ BOOST_AUTO_TEST_CASE( join_test )
         (r1 | linq::sequence_equal(q)) ||
         (r2 | linq::sequence_equal(q))
     );
+
+    // The results are in the order of the outer range, and then the inner range
+    CHECK_SEQ(r1, q);
+
+    // A named inner range is referenced, and a temporary one is copied
+    auto refs = people | linq::join(pets, 
+        [](const person& p) { return p.name; },
+        [](const pet& p) { return p.owner; },
+        [](const person&, const pet& p) { return &p; });
+    BOOST_CHECK_EQUAL(&pets[2], *boost::begin(refs));
+    auto copies = people | linq::join(std::vector<pet>(pets), 
+        [](const person& p) { return p.name; },
+        [](const pet& p) { return p.owner; },
+        [](const person&, const pet& p) { return p.name; });
+    CHECK_SEQ(r1, copies);
+
+    // More outer elements than a batch, with keys that aren't in the inner range
+    std::list<int> outer;
+    for(int i = 0; i < 1000; i++) outer.push_back((i * 7919) % 1000);
+    std::vector<int> inner;
+    for(int i = 0; i < 300; i++) inner.push_back(i * 3);
+    auto id = [](int x) { return x; };
+    auto pair = [](int x, int y) { return std::make_pair(x, y); };
+    std::vector<std::pair<int, int>> expected;
+    for(int x : outer) for(int y : inner) if (x == y % 1000) expected.push_back(std::make_pair(x, y));
+    auto j = outer | linq::join(inner, id, [](int y) { return y % 1000; }, pair);
+    std::vector<std::pair<int, int>> result = j | linq::to_container;
+    BOOST_CHECK(expected == result);
+    std::vector<std::string> words = list_of("b")("a")("c")("a");
+    std::vector<std::string> letters = list_of("a")("b")("a");
+    auto str = [](const std::string& x) { return x; };
+    auto concat = [](const std::string& x, const std::string& y) { return x + y; };
+    std::vector<std::string> joined = list_of("bb")("aa")("aa")("aa")("aa");
+    CHECK_SEQ(joined, words | linq::join(letters, str, str, concat));
+    BOOST_CHECK(boost::empty(words | linq::join(std::vector<std::string>(), str, str, concat)));
+
+    // The smaller range is hashed, and the order stays the same
+    std::vector<int> few = list_of(12)(3)(5000)(12)(7);
+    std::vector<int> lots;
+    for(int i = 0; i < 3000; i++) lots.push_back((i * 7919) % 1000);
+    auto mod = [](int y) { return y % 1000; };
+    std::vector<std::pair<int, int>> inner_first = few | linq::join(lots, id, mod, pair, linq::build_inner) | linq::to_container;
+    std::vector<std::pair<int, int>> outer_first = few | linq::join(lots, id, mod, pair, linq::build_outer) | linq::to_container;
+    std::vector<std::pair<int, int>> chosen = few | linq::join(lots, id, mod, pair) | linq::to_container;
+    std::vector<std::pair<int, int>> copied = few | linq::join(std::vector<int>(lots), id, mod, pair, linq::build_outer) | linq::to_container;
+    BOOST_CHECK_EQUAL(12, inner_first.size());
+    BOOST_CHECK(inner_first == outer_first);
+    BOOST_CHECK(inner_first == chosen);
+    BOOST_CHECK(inner_first == copied);
+    std::vector<std::pair<int, int>> from_list = outer | linq::join(inner, id, [](int y) { return y % 1000; }, pair, linq::build_outer) | linq::to_container;
+    BOOST_CHECK(expected == from_list);
+
+    // Only the outer range is hashed, with the results in the order of the
+    // inner range
+    std::vector<std::pair<int, int>> inner_major;
+    for(std::size_t i = 0; i < lots.size(); i++)
+        for(std::size_t j = 0; j < few.size(); j++) if (few[j] == mod(lots[i])) inner_major.push_back(pair(few[j], lots[i]));
+    std::vector<std::pair<int, int>> probed = few | linq::join(lots, id, mod, pair, linq::probe_inner) | linq::to_container;
+    BOOST_CHECK(inner_major == probed);
+
+    // Joined by partitions, in parallel, with the results in the same order
+    std::vector<std::pair<int, int>> partitioned = outer | linq::join(inner, id, [](int y) { return y % 1000; }, pair, linq::build_partitioned) | linq::to_container;
+    BOOST_CHECK(expected == partitioned);
+    std::vector<long> big_outer;
+    std::vector<long> big_inner;
+    for(long i = 0; i < 50000; i++) big_outer.push_back((i * 7919) % 30011);
+    for(long i = 0; i < 40000; i++) big_inner.push_back((i * 104729) % 20011);
+    auto lid = [](long x) { return x; };
+    auto lpair = [](long x, long y) { return std::make_pair(x, y); };
+    std::vector<std::pair<long, long>> big_expected = big_outer | linq::join(big_inner, lid, lid, lpair, linq::build_inner) | linq::to_container;
+    auto big = big_outer | linq::join(big_inner, lid, lid, lpair, linq::build_partitioned);
+    std::vector<std::pair<long, long>> big_partitioned = big | linq::to_container;
+    BOOST_CHECK(big_expected == big_partitioned);
+    BOOST_CHECK_EQUAL(big_expected.size(), boost::size(big));
+    std::vector<std::string> partitioned_copies = words | linq::join(std::vector<std::string>(letters), str, str, concat, linq::build_partitioned) | linq::to_container;
+    CHECK_SEQ(joined, partitioned_copies);
 }
 #endif
 BOOST_AUTO_TEST_CASE( intersect_test )
@@ -447,6 +740,11 @@ BOOST_AUTO_TEST_CASE( intersect_test )
     std::vector<int> v2 = list_of(2)(4);
     std::vector<int> i = list_of(2)(4);
     BOOST_CHECK(v1 | linq::intersect(v2) | linq::sequence_equal(i));
+
+    // Each element is only in the intersection once
+    std::vector<int> v3 = list_of(4)(2)(4)(9)(2);
+    std::vector<int> i3 = list_of(4)(2);
+    CHECK_SEQ(i3, v3 | linq::intersect(v1));
 }
 
 BOOST_AUTO_TEST_CASE( keys_test )
@@ -486,6 +784,88 @@ BOOST_AUTO_TEST_CASE( min_test )
     BOOST_CHECK_EQUAL(1, v | linq::min);
 }
 #ifndef _MSC_VER
+BOOST_AUTO_TEST_CASE( merge_join_test )
+{
+    std::vector<int> outer = list_of(1)(2)(2)(4)(5)(5)(9);
+    std::vector<int> inner = list_of(0)(2)(2)(2)(3)(5)(9)(9)(10);
+    auto id = [](int x) { return x; };
+    auto pair = [](int x, int y) { return std::make_pair(x, y); };
+    std::vector<std::pair<int, int>> expected = outer | linq::join(inner, id, id, pair) | linq::to_container;
+    std::vector<std::pair<int, int>> merged = outer | linq::merge_join(inner, id, id, pair) | linq::to_container;
+    BOOST_CHECK_EQUAL(10, merged.size());
+    BOOST_CHECK(expected == merged);
+
+    // The outer and inner rows are read from the ranges
+    std::vector<person> people = list_of
+    (person("Bob", 22))
+    (person("Jerry", 22))
+    (person("Tom", 25))
+    (person("Terry", 37));
+    std::list<int> ages = list_of(22)(30)(37)(37);
+    auto names = ages | linq::merge_join(people, id, [](const person& p) { return p.age; }, [](int, const person& p) -> const std::string& { return p.name; });
+    std::vector<std::string> r = list_of("Bob")("Jerry")("Terry")("Terry");
+    CHECK_SEQ(r, names);
+    BOOST_CHECK_EQUAL(&people[3].name, &*boost::next(boost::begin(names), 2));
+
+    std::vector<int> empty;
+    BOOST_CHECK(boost::empty(empty | linq::merge_join(inner, id, id, pair)));
+    BOOST_CHECK(boost::empty(outer | linq::merge_join(empty, id, id, pair)));
+
+    std::vector<int> big_outer;
+    std::vector<int> big_inner;
+    for(int i = 0; i < 3000; i++) big_outer.push_back(i / 3);
+    for(int i = 0; i < 2000; i++) big_inner.push_back(i / 4 * 2);
+    std::vector<std::pair<int, int>> big_expected = big_outer | linq::join(big_inner, id, id, pair) | linq::to_container;
+    std::vector<std::pair<int, int>> big_merged = big_outer | linq::merge_join(big_inner, id, id, pair) | linq::to_container;
+    BOOST_CHECK(big_expected == big_merged);
+}
+
+BOOST_AUTO_TEST_CASE( merge_sorted_test )
+{
+    std::vector<person> shard1 = list_of(person("Bob", 22))(person("Tom", 25))(person("Terry", 37));
+    std::vector<person> shard2 = list_of(person("Jerry", 22))(person("Ann", 30));
+    std::vector<person> shard3;
+    std::vector<std::vector<person> > shards = list_of(shard1)(shard2)(shard3);
+
+    auto age_select = [](const person& p) { return p.age; };
+    auto name_select = [](const person& p) { return p.name; };
+
+    // Equal keys come from the earlier range first
+    std::vector<std::string> merged = list_of("Bob")("Jerry")("Tom")("Ann")("Terry");
+    CHECK_SEQ(merged, shard1 | linq::merge_sorted(shard2, age_select) | linq::select(name_select));
+    CHECK_SEQ(merged, shard1 | linq::merge_sorted(shard3, shard2, age_select) | linq::select(name_select));
+    CHECK_SEQ(merged, shards | linq::merge_sorted(age_select) | linq::select(name_select));
+    BOOST_CHECK(boost::empty(shard3 | linq::merge_sorted(shard3, age_select)));
+
+    // The elements refer to the sources
+    BOOST_CHECK_EQUAL(&shard2[0], &(shard2 | linq::merge_sorted(shard1, age_select) | linq::first));
+
+    std::vector<std::string> top = list_of("Bob")("Jerry");
+    CHECK_SEQ(top, shard1 | linq::merge_sorted(shard2, age_select) | linq::take(2) | linq::select(name_select));
+    // The copies of an iterator share the heap until one of them moves
+    auto m = shard1 | linq::merge_sorted(shard2, age_select);
+    auto it = boost::begin(m);
+    auto copy = it;
+    ++it;
+    ++it;
+    BOOST_CHECK_EQUAL("Bob", (*copy).name);
+    BOOST_CHECK_EQUAL("Tom", (*it).name);
+    ++copy;
+    BOOST_CHECK_EQUAL("Jerry", (*copy).name);
+    std::vector<std::string> then = list_of("Jerry")("Bob")("Tom")("Ann")("Terry");
+    CHECK_SEQ(then, shard1 | linq::merge_sorted(shard2, age_select) | linq::then_by_descending(name_select) | linq::select(name_select));
+    BOOST_CHECK_EQUAL("Jerry", (shard1 | linq::merge_sorted(shard2, age_select) | linq::then_by_descending(name_select) | linq::first).name);
+
+    std::vector<int> v1, v2, v3;
+    for(int i = 0; i < 1000; i++) (i % 3 == 0 ? v1 : i % 3 == 1 ? v2 : v3).push_back(i / 2);
+    std::vector<int> all = v1 | linq::concat(v2) | linq::concat(v3) | linq::to_container;
+    std::stable_sort(all.begin(), all.end());
+    auto identity = [](int x) { return x; };
+    CHECK_SEQ(all, v1 | linq::merge_sorted(v2, v3, identity));
+    CHECK_SEQ(all, v1 | linq::merge_sorted(v2, v3, identity) | linq::then_by(identity));
+}
+#endif
+#ifndef _MSC_VER
 BOOST_AUTO_TEST_CASE( order_by_test )
 {
     std::vector<person> people = list_of
@@ -500,8 +880,128 @@ BOOST_AUTO_TEST_CASE( order_by_test )
 
     CHECK_SEQ(people_age, people | linq::order_by(age_select) | linq::select(age_select));
     CHECK_SEQ(people_age | linq::reverse, people | linq::order_by_descending(age_select) | linq::select(age_select));
+
+    // The sort is stable and refers to the elements of the source
+    std::vector<std::string> people_name = list_of("Bob")("Jerry")("Tom")("Terry");
+    CHECK_SEQ(people_name, people | linq::order_by(age_select) | linq::select([](person p) { return p.name; }));
+    BOOST_CHECK_EQUAL(&people[1], &(people | linq::order_by(age_select) | linq::first));
+
+    // The first elements are selected without sorting everything, and they
+    // are the same elements as in the full sort
+    std::vector<int> v;
+    for(int i = 0; i < 1000; i++) v.push_back((i * 37) % 101);
+    auto third = [](int x) { return x / 3; };
+    auto address = [](const int& x) { return &x; };
+    std::vector<const int*> sorted = v | linq::order_by(third) | linq::select(address) | linq::to_container;
+    std::vector<const int*> top(sorted.begin(), sorted.begin() + 10);
+    CHECK_SEQ(top, v | linq::order_by(third) | linq::take(10) | linq::select(address));
+    CHECK_SEQ(sorted, v | linq::order_by(third) | linq::take(5000) | linq::select(address));
+    BOOST_CHECK(boost::empty(v | linq::order_by(third) | linq::take(0)));
+    BOOST_CHECK_EQUAL(sorted[0], &(v | linq::order_by(third) | linq::first));
+    BOOST_CHECK_EQUAL(sorted[17], &(v | linq::order_by(third) | linq::element_at(17)));
+    BOOST_CHECK_EQUAL(sorted[999], &(v | linq::order_by(third) | linq::last));
+    BOOST_CHECK_EQUAL(sorted[9], &(v | linq::order_by(third) | linq::take(10) | linq::last));
+    BOOST_CHECK_THROW(v | linq::order_by(third) | linq::element_at(1000), std::out_of_range);
+
+    // then_by keeps the limit of take
+    auto tenth = [](int x) { return x % 10; };
+    std::vector<const int*> sorted_by_both = v | linq::order_by(third) | linq::then_by(tenth) | linq::select(address) | linq::to_container;
+    std::vector<const int*> top_by_both(sorted_by_both.begin(), sorted_by_both.begin() + 3);
+    CHECK_SEQ(top_by_both, v | linq::order_by(third) | linq::take(3) | linq::then_by(tenth) | linq::select(address));
+
+    // Integer and floating point keys are radix sorted, and the sort is
+    // still stable
+    std::vector<const int*> expected;
+    for(std::size_t i = 0; i < v.size(); i++) expected.push_back(&v[i]);
+    std::stable_sort(expected.begin(), expected.end(), [](const int* x, const int* y) { return *x / 3 < *y / 3; });
+    CHECK_SEQ(expected, v | linq::order_by(third) | linq::select(address));
+    std::stable_sort(expected.begin(), expected.end(), [](const int* x, const int* y) { return *x / 3 > *y / 3; });
+    CHECK_SEQ(expected, v | linq::order_by_descending(third) | linq::select(address));
+    auto signed_half = [](int x) { return (x - 50) * 0.5; };
+    std::stable_sort(expected.begin(), expected.end(), [](const int* x, const int* y) { return (*x - 50) * 0.5 < (*y - 50) * 0.5; });
+    CHECK_SEQ(expected, v | linq::order_by(signed_half) | linq::select(address));
+    auto parity = [](int x) { return x % 2 == 0; };
+    auto negative = [](int x) { return 50 - x; };
+    std::stable_sort(expected.begin(), expected.end(), [](const int* x, const int* y)
+    {
+        if ((*x % 2 == 0) != (*y % 2 == 0)) return (*x % 2 == 0) > (*y % 2 == 0);
+        return 50 - *x < 50 - *y;
+    });
+    CHECK_SEQ(expected, v | linq::order_by_descending(parity) | linq::then_by(negative) | linq::select(address));
+
+    // Inputs that are sorted, or made of a few sorted or descending runs,
+    // are sorted by merging the runs
+    std::vector<int> runs;
+    for(int i = 0; i < 1000; i++) runs.push_back(i / 4);
+    for(int i = 0; i < 1000; i++) runs.push_back(1000 - i);
+    for(int i = 0; i < 1000; i++) runs.push_back(i % 500);
+    auto half = [](int x) { return x / 2; };
+    std::vector<const int*> expected_runs;
+    for(std::size_t i = 0; i < 1000; i++) expected_runs.push_back(&runs[i]);
+    CHECK_SEQ(expected_runs, runs | linq::take(1000) | linq::order_by(half) | linq::select(address));
+    for(std::size_t i = 1000; i < runs.size(); i++) expected_runs.push_back(&runs[i]);
+    std::stable_sort(expected_runs.begin(), expected_runs.end(), [](const int* x, const int* y) { return *x / 2 < *y / 2; });
+    CHECK_SEQ(expected_runs, runs | linq::order_by(half) | linq::select(address));
+    std::stable_sort(expected_runs.begin(), expected_runs.end(), [](const int* x, const int* y) { return *x / 2 > *y / 2; });
+    CHECK_SEQ(expected_runs, runs | linq::order_by_descending(half) | linq::select(address));
 }
 #endif
+BOOST_AUTO_TEST_CASE( par_test )
+{
+    std::vector<int> v;
+    for(int i = 0; i < 100000; i++) v.push_back(i % 1000);
+    auto times_3 = [](int x) { return x * 3; };
+    auto is_big = [](int x) { return x > 2900; };
+
+    BOOST_CHECK_EQUAL(v | linq::where(odd()) | linq::select(times_3) | linq::sum, v | linq::par(4) | linq::where(odd()) | linq::select(times_3) | linq::sum);
+    BOOST_CHECK_EQUAL(1, v | linq::par(4) | linq::where(odd()) | linq::min);
+    BOOST_CHECK_EQUAL(999, v | linq::par(4) | linq::max);
+    BOOST_CHECK_EQUAL(50000, v | linq::par(4) | linq::where(odd()) | linq::count);
+    BOOST_CHECK_EQUAL(v | linq::count(is_big), v | linq::par(4) | linq::count(is_big));
+    BOOST_CHECK_EQUAL(v | linq::aggregate(0L, std::plus<long>()), v | linq::par(4) | linq::aggregate(0L, std::plus<long>(), std::plus<long>()));
+    auto add_square = [](long s, int x) { return s + long(x) * x; };
+    BOOST_CHECK_EQUAL(v | linq::aggregate(0L, add_square), v | linq::par(4) | linq::aggregate(0L, add_square, std::plus<long>()));
+    BOOST_CHECK_EQUAL((v | linq::aggregate(0L, add_square)) / 2, v | linq::par(4) | linq::aggregate(0L, add_square, std::plus<long>(), [](long s) { return s / 2; }));
+    BOOST_CHECK_EQUAL(v | linq::aggregate(0L, add_square), v | linq::fused | linq::aggregate(0L, add_square, std::plus<long>()));
+    BOOST_CHECK(v | linq::par(4) | linq::any([](int x) { return x == 999; }));
+    BOOST_CHECK(!(v | linq::par(4) | linq::all([](int x) { return x < 999; })));
+
+    std::vector<int> r = v | linq::par(4) | linq::where(odd()) | linq::select(times_3) | linq::to_container;
+    CHECK_SEQ(v | linq::where(odd()) | linq::select(times_3), r);
+    CHECK_SEQ(v | linq::where(odd()), v | linq::par | linq::where(odd()));
+
+    linq::thread_pool pool(3);
+    BOOST_CHECK_EQUAL(v | linq::count(is_big), v | linq::par(pool) | linq::count(is_big));
+    inline_executor e;
+    BOOST_CHECK_EQUAL(v | linq::count(is_big), v | linq::par(e) | linq::count(is_big));
+}
+
+BOOST_AUTO_TEST_CASE( par_order_by_test )
+{
+    std::vector<int> v;
+    for(int i = 0; i < 200000; i++) v.push_back((i * 7919) % 10007);
+    auto bucket = [](int x) { return x / 10; };
+    auto name = [](int x) { return std::to_string(x % 100); };
+    auto address = [](const int& x) { return &x; };
+    linq::thread_pool pool(3);
+
+    std::vector<const int*> expected = v | linq::order_by(bucket) | linq::select(address) | linq::to_container;
+    CHECK_SEQ(expected, v | linq::par(pool) | linq::order_by(bucket) | linq::select(address));
+    std::vector<const int*> expected_then = v | linq::order_by_descending(name) | linq::then_by(bucket) | linq::select(address) | linq::to_container;
+    CHECK_SEQ(expected_then, v | linq::par(pool) | linq::order_by_descending(name) | linq::then_by(bucket) | linq::select(address));
+    std::vector<const int*> expected_odd = v | linq::where(odd()) | linq::order_by(name) | linq::select(address) | linq::to_container;
+    CHECK_SEQ(expected_odd, v | linq::par(5) | linq::where(odd()) | linq::order_by(name) | linq::select(address));
+}
+
+BOOST_AUTO_TEST_CASE( parallel_for_test )
+{
+    linq::thread_pool pool(4);
+    std::vector<int> v(1000, 0);
+    linq::parallel_for(pool, 0, v.size(), [&](std::size_t i) { v[i] = i; });
+    for(std::size_t i = 0; i < v.size(); i++) BOOST_CHECK_EQUAL(i, v[i]);
+    BOOST_CHECK_THROW(linq::parallel_for(pool, 0, 10, [](std::size_t i) { if (i == 7) throw std::runtime_error("error"); }), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE( reverse_test )
 {
     std::vector<int> v1 = list_of(3)(2)(1);
@@ -529,6 +1029,35 @@ BOOST_AUTO_TEST_CASE( select_test )
     BOOST_CHECK(v | linq::select([](int i) { return i * 3; }) | linq::sequence_equal(r));
 }
 
+BOOST_AUTO_TEST_CASE( simd_test )
+{
+    // Long enough to go through the vector loop and the tail
+    std::vector<int> v;
+    for(int i = 0; i < 1003; i++) v.push_back((i * 37) % 1001 - 500);
+    std::vector<int> empty_v;
+    int expected_sum = 0;
+    for(int i = 0; i < 1003; i++) expected_sum += v[i];
+    BOOST_CHECK_EQUAL(expected_sum, v | linq::sum);
+    BOOST_CHECK_EQUAL(-500, v | linq::min);
+    BOOST_CHECK_EQUAL(500, v | linq::max);
+    BOOST_CHECK_EQUAL(0, empty_v | linq::sum);
+    BOOST_CHECK_THROW(empty_v | linq::min, std::out_of_range);
+    BOOST_CHECK_EQUAL(v | linq::where(odd()) | linq::sum, v | linq::take(1003) | linq::where(odd()) | linq::sum);
+    BOOST_CHECK_EQUAL(v | linq::skip(500) | linq::select([](int x) { return x; }) | linq::max, v | linq::skip(500) | linq::max);
+
+    std::vector<double> d;
+    for(int i = 0; i < 1001; i++) d.push_back(0.5 * i);
+    BOOST_CHECK_EQUAL(250250.0, d | linq::sum);
+    BOOST_CHECK_EQUAL(250.0, d | linq::average);
+    BOOST_CHECK_EQUAL(0.0, d | linq::min);
+    BOOST_CHECK_EQUAL(500.0, d | linq::max);
+
+    float f[] = { 3.0f, -1.0f, 4.0f, 1.0f, 5.0f, 9.0f, 2.0f, 6.0f, 5.0f, 3.0f, 5.0f, 8.0f, 9.0f, 7.0f, 9.0f, 3.0f, 2.0f, 3.0f, 8.0f, 4.0f, 6.0f, 2.0f, 6.0f, 4.0f, 3.0f, 3.0f, 8.0f, 3.0f, 2.0f, 7.0f, 9.0f, 5.0f, 0.0f };
+    BOOST_CHECK_EQUAL(153.0f, boost::make_iterator_range(f) | linq::sum);
+    BOOST_CHECK_EQUAL(-1.0f, boost::make_iterator_range(f) | linq::min);
+    BOOST_CHECK_EQUAL(9.0f, boost::make_iterator_range(f) | linq::max);
+}
+
 BOOST_AUTO_TEST_CASE( single_test )
 {
     std::vector<int> v = list_of(1);
@@ -557,6 +1086,57 @@ BOOST_AUTO_TEST_CASE( skip_while_test )
     CHECK_SEQ(r, v | linq::skip_while(odd()));
 }
 
+BOOST_AUTO_TEST_CASE( spill_test )
+{
+    std::vector<person> people;
+    for(int i = 0; i < 5000; i++) people.push_back(person("p" + std::to_string((i * 31) % 977), (i * 7) % 90));
+    auto age_select = [](const person& p) { return p.age; };
+    auto name_select = [](const person& p) { return p.name; };
+
+    // A small budget writes many runs
+    std::vector<std::string> expected = people | linq::order_by(age_select) | linq::then_by_descending(name_select) | linq::select(name_select) | linq::to_container;
+    CHECK_SEQ(expected, people | linq::order_by(age_select) | linq::then_by_descending(name_select) | linq::spill(4096) | linq::select(name_select));
+    CHECK_SEQ(expected, people | linq::order_by(age_select) | linq::then_by_descending(name_select) | linq::spill(1 << 30) | linq::select(name_select));
+
+    // The merge is stable
+    std::vector<int> v;
+    for(int i = 0; i < 10000; i++) v.push_back((i * 7919) % 10007);
+    auto bucket = [](int x) { return x / 100; };
+    std::vector<int> expected_v = v | linq::order_by(bucket) | linq::to_container;
+    CHECK_SEQ(expected_v, v | linq::order_by(bucket) | linq::spill(1000));
+    std::vector<int> top_v(expected_v.begin(), expected_v.begin() + 50);
+    CHECK_SEQ(top_v, v | linq::order_by(bucket) | linq::take(50) | linq::spill(1000));
+    std::vector<int> empty_v;
+    BOOST_CHECK(boost::empty(empty_v | linq::order_by(bucket) | linq::spill(1000)));
+}
+
+BOOST_AUTO_TEST_CASE( serializer_test )
+{
+    std::FILE * f = std::tmpfile();
+    linq::serializer<std::string>::write(f, "hello");
+    linq::serializer<int>::write(f, 7);
+    std::rewind(f);
+    std::string s;
+    int x = 0;
+    BOOST_CHECK(linq::serializer<std::string>::read(f, s));
+    BOOST_CHECK_EQUAL("hello", s);
+    BOOST_CHECK(linq::serializer<int>::read(f, x));
+    BOOST_CHECK_EQUAL(7, x);
+    BOOST_CHECK(!linq::serializer<int>::read(f, x));
+    std::fclose(f);
+
+    // A value that is cut short throws, instead of looking like the end
+    f = std::tmpfile();
+    linq::serializer<std::size_t>::write(f, 5);
+    std::fwrite("he", 1, 2, f);
+    std::rewind(f);
+    BOOST_CHECK_THROW(linq::serializer<std::string>::read(f, s), std::runtime_error);
+    std::rewind(f);
+    std::pair<std::size_t, int> p;
+    BOOST_CHECK_THROW((linq::serializer<std::pair<std::size_t, int> >::read(f, p)), std::runtime_error);
+    std::fclose(f);
+}
+
 BOOST_AUTO_TEST_CASE( sum_test )
 {
     std::vector<int> v = list_of(1)(2)(3);
@@ -593,6 +1173,34 @@ BOOST_AUTO_TEST_CASE( then_by_test )
 
     CHECK_SEQ(people_name, people | linq::order_by(age_select) | linq::then_by(name_select) | linq::select(name_select));
     CHECK_SEQ(people_name_d, people | linq::order_by(age_select) | linq::then_by_descending(name_select) | linq::select(name_select));
+
+    // The keys are computed once for each element
+    int calls = 0;
+    auto counted_age_select = [&calls](person p) { calls++; return p.age; };
+    CHECK_SEQ(people_name, people | linq::order_by(counted_age_select) | linq::then_by(name_select) | linq::select(name_select));
+    BOOST_CHECK_EQUAL(4, calls);
+
+    // A longer chain compares the keys in order, and integer keys are radix sorted
+    std::vector<int> v;
+    for(int i = 0; i < 2000; i++) v.push_back((i * 7919) % 1000);
+    std::vector<int> expected = v;
+    std::stable_sort(expected.begin(), expected.end(), [](int x, int y)
+    {
+        if (x % 2 != y % 2) return x % 2 < y % 2;
+        if (x % 5 != y % 5) return x % 5 > y % 5;
+        if (x % 7 != y % 7) return x % 7 < y % 7;
+        return x > y;
+    });
+    CHECK_SEQ(expected, v
+        | linq::order_by([](int x) { return x % 2; })
+        | linq::then_by_descending([](int x) { return x % 5; })
+        | linq::then_by([](int x) { return x % 7; })
+        | linq::then_by_descending([](int x) { return x; }));
+    CHECK_SEQ(expected, v
+        | linq::order_by([](int x) { return x % 2; })
+        | linq::then_by_descending([](int x) { return std::to_string(x % 5); })
+        | linq::then_by([](int x) { return x % 7; })
+        | linq::then_by_descending([](int x) { return x; }));
 }
 #endif
 BOOST_AUTO_TEST_CASE( to_container_test )
@@ -603,6 +1211,42 @@ BOOST_AUTO_TEST_CASE( to_container_test )
     BOOST_CHECK(l | linq::sequence_equal(r));
 }
 
+#ifndef _MSC_VER
+BOOST_AUTO_TEST_CASE( to_lookup_test )
+{
+    std::vector<person> v = list_of
+    (person("Tom", 25))
+    (person("Bob", 22))
+    (person("Terry", 37))
+    (person("Jerry", 22));
+
+    auto q = v | linq::to_lookup([](const person& p) { return p.age; }, [](const person& p) { return p.name; });
+    BOOST_CHECK_EQUAL(3, q.size());
+    std::vector<int> keys = list_of(25)(22)(37);
+    CHECK_SEQ(keys, q.keys());
+    std::vector<std::string> names = list_of("Bob")("Jerry");
+    CHECK_SEQ(names, q[22]);
+    BOOST_CHECK(boost::empty(q[30]));
+    BOOST_CHECK(q.contains(37));
+    BOOST_CHECK(!q.contains(30));
+    BOOST_CHECK_EQUAL(22, q.find(22)->key());
+    BOOST_CHECK(q.find(30) == q.end());
+
+    std::vector<std::size_t> counts = list_of(1)(2)(1);
+    CHECK_SEQ(counts, q | linq::select([](linq::lookup<int, std::string>::value_type g) { return boost::size(g); }));
+
+    // A range without random access is put in place in one pass
+    std::list<int> l;
+    for(int i = 0; i < 1000; i++) l.push_back((i * 7919) % 1000);
+    auto lq = l | linq::to_lookup([](int x) { return x % 10; });
+    BOOST_CHECK_EQUAL(10, lq.size());
+    for(auto&& g : lq)
+    {
+        std::vector<int> expected = l | linq::where([&g](int x) { return x % 10 == g.key(); }) | linq::to_container;
+        CHECK_SEQ(expected, g);
+    }
+}
+#endif
 BOOST_AUTO_TEST_CASE( union_test )
 {
     std::vector<int> v1 = list_of(1)(3)(5)(7)(9);